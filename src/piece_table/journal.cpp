@@ -0,0 +1,308 @@
+#include "journal.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include "journal_file.hpp"
+
+namespace piece_table_detail
+{
+    struct JournalState
+    {
+        JournalFile file;
+        std::string path;
+        size_t charSize;
+        bool created; // the file is created by the first checkpoint, the records before it are collected here
+        std::vector<char> initialRecords;
+
+        // the table index of every buffer in the file by its number, so increasing, and where its record is
+        std::vector<size_t> bufferIndexes;
+        std::vector<std::pair<size_t, size_t>> bufferRecords;
+        size_t fileSize; // including everything queued
+        size_t editsSinceCheckpoint;
+        std::vector<char> body;
+
+        JournalState(const std::string &path, size_t charSize, size_t syncIntervalMs)
+            : file(std::chrono::milliseconds(syncIntervalMs)), path(path), charSize(charSize), created(false),
+              fileSize(JOURNAL_HEADER_SIZE), editsSinceCheckpoint(0) {}
+
+        size_t getBufferNumber(size_t bufferIndex) const
+        {
+            return std::lower_bound(bufferIndexes.begin(), bufferIndexes.end(), bufferIndex) - bufferIndexes.begin();
+        }
+
+        bool write(JournalRecordType type)
+        {
+            fileSize += JOURNAL_FRAME_SIZE + body.size();
+            if (!created)
+            {
+                journalWriteRecord(initialRecords, type, body);
+                return true;
+            }
+            return file.write(type, body);
+        }
+    };
+
+    Journal::Journal() = default;
+
+    Journal::~Journal() = default;
+
+    // the error is reported by isOpen and sync
+    void Journal::fail()
+    {
+        state.reset();
+    }
+
+    bool Journal::isOpen() const
+    {
+        return state != nullptr;
+    }
+
+    bool Journal::hasEditsSinceCheckpoint() const
+    {
+        return state != nullptr && (!state->created || state->editsSinceCheckpoint != 0);
+    }
+
+    void Journal::create(const std::string &path, size_t charSize, size_t syncIntervalMs)
+    {
+        state.reset(new JournalState(path, charSize, syncIntervalMs));
+    }
+
+    bool Journal::read(const std::string &path, size_t charSize, JournalContent &content)
+    {
+        std::vector<JournalRecord> records;
+        if (!readJournal(path, charSize, content.file, records, content.validLength))
+        {
+            return false;
+        }
+
+        bool restored = false;
+        for (const JournalRecord &record : records)
+        {
+            const char *data = record.body;
+            const char *end = record.body + record.size;
+            uint64_t count, values[4];
+
+            if (record.type == JOURNAL_BUFFER)
+            {
+                if (!journalReadNumber(data, end, values[0]) || values[0] > size_t(end - data) / charSize)
+                    return false;
+                size_t recordOffset = record.body - content.file.data() - 5; // type and body size
+                content.buffers.push_back(JournalBuffer{recordOffset, JOURNAL_FRAME_SIZE + record.size, size_t(data - content.file.data()), size_t(values[0])});
+            }
+            else if (record.type == JOURNAL_CHECKPOINT)
+            {
+                // only the last checkpoint and the edits after it are replayed
+                content.pieces.clear();
+                content.edits.clear();
+                if (!journalReadNumber(data, end, count) || count > size_t(end - data) / 3)
+                    return false;
+                for (uint64_t piece = 0; piece < count; piece++)
+                {
+                    if (!journalReadNumber(data, end, values[0]) || !journalReadNumber(data, end, values[1]) || !journalReadNumber(data, end, values[2]) ||
+                        values[0] >= content.buffers.size() || values[1] >= values[2] || values[2] > content.buffers[size_t(values[0])].length)
+                        return false;
+                    content.pieces.insert(content.pieces.end(), values, values + 3);
+                }
+                restored = true;
+            }
+            else if (record.type == JOURNAL_EDIT)
+            {
+                // the offsets are checked against the document while it is replayed
+                for (uint64_t &value : values)
+                {
+                    if (!journalReadNumber(data, end, value))
+                        return false;
+                }
+                if (!restored || values[2] > content.buffers.size() || values[3] > content.buffers.size() - values[2])
+                    return false;
+                content.edits.insert(content.edits.end(), values, values + 4);
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return restored;
+    }
+
+    bool Journal::resume(const std::string &path, size_t charSize, size_t syncIntervalMs, const JournalContent &content)
+    {
+        state.reset(new JournalState(path, charSize, syncIntervalMs));
+        for (size_t i = 0; i < content.buffers.size(); i++)
+        {
+            state->bufferIndexes.push_back(i);
+            state->bufferRecords.emplace_back(content.buffers[i].recordOffset, content.buffers[i].recordSize);
+        }
+        state->created = true;
+        state->fileSize = content.validLength;
+        state->editsSinceCheckpoint = content.edits.size() / 4;
+        if (!state->file.append(path, charSize, content.validLength))
+        {
+            fail();
+            return false;
+        }
+        return true;
+    }
+
+    void Journal::writeBuffer(size_t bufferIndex, const void *text, size_t length)
+    {
+        if (state == nullptr)
+        {
+            return;
+        }
+
+        const char *bytes = static_cast<const char *>(text);
+        std::vector<char> &body = state->body;
+        body.clear();
+        journalWriteNumber(body, length);
+        body.insert(body.end(), bytes, bytes + length * state->charSize);
+
+        state->bufferIndexes.push_back(bufferIndex);
+        state->bufferRecords.emplace_back(state->fileSize, JOURNAL_FRAME_SIZE + body.size());
+        if (!state->write(JOURNAL_BUFFER))
+        {
+            fail();
+        }
+    }
+
+    void Journal::writeEdit(size_t offset, size_t removedLength, size_t firstBuffer, size_t bufferCount)
+    {
+        if (state == nullptr)
+        {
+            return;
+        }
+
+        std::vector<char> &body = state->body;
+        body.clear();
+        journalWriteNumber(body, offset);
+        journalWriteNumber(body, removedLength);
+        journalWriteNumber(body, state->getBufferNumber(firstBuffer));
+        journalWriteNumber(body, bufferCount);
+        state->editsSinceCheckpoint++;
+        if (!state->write(JOURNAL_EDIT))
+        {
+            fail();
+        }
+    }
+
+    void Journal::writeCheckpoint(const std::vector<size_t> &pieces)
+    {
+        if (state == nullptr)
+        {
+            return;
+        }
+
+        std::vector<size_t> numbers(pieces.size() / 3);
+        for (size_t i = 0; i < numbers.size(); i++)
+        {
+            numbers[i] = state->getBufferNumber(pieces[3 * i]);
+        }
+        // the number every used buffer gets when the file is compacted, they keep their order
+        const size_t UNUSED = size_t(-1);
+        std::vector<size_t> newNumbers(state->bufferIndexes.size(), UNUSED);
+        for (size_t number : numbers)
+        {
+            newNumbers[number] = 0;
+        }
+        std::vector<size_t> usedNumbers;
+        size_t usedSize = JOURNAL_HEADER_SIZE;
+        for (size_t number = 0; number < newNumbers.size(); number++)
+        {
+            if (newNumbers[number] != UNUSED)
+            {
+                newNumbers[number] = usedNumbers.size();
+                usedNumbers.push_back(number);
+                usedSize += state->bufferRecords[number].second;
+            }
+        }
+
+        std::vector<char> &body = state->body;
+        auto writeBody = [&]()
+        {
+            body.clear();
+            journalWriteNumber(body, numbers.size());
+            for (size_t i = 0; i < numbers.size(); i++)
+            {
+                journalWriteNumber(body, numbers[i]);
+                journalWriteNumber(body, pieces[3 * i + 1]);
+                journalWriteNumber(body, pieces[3 * i + 2]);
+            }
+        };
+        writeBody();
+
+        // a compacted file at most half as big is worth copying the used buffers. That keeps the file below about
+        // twice the used buffers and the last checkpoint (plus the edits after it) and the writer copies O(1) per
+        // written byte on average
+        bool compact = state->created && state->fileSize > 2 * (usedSize + JOURNAL_FRAME_SIZE + body.size());
+        if (compact)
+        {
+            for (size_t &number : numbers)
+            {
+                number = newNumbers[number];
+            }
+            writeBody();
+        }
+        state->editsSinceCheckpoint = 0;
+
+        bool written;
+        if (!state->created)
+        {
+            state->write(JOURNAL_CHECKPOINT);
+            written = state->file.create(state->path, state->charSize, state->initialRecords);
+            state->created = true;
+            std::vector<char>().swap(state->initialRecords);
+        }
+        else if (compact)
+        {
+            std::vector<std::pair<size_t, size_t>> ranges;
+            std::vector<size_t> bufferIndexes;
+            ranges.reserve(usedNumbers.size());
+            bufferIndexes.reserve(usedNumbers.size());
+            for (size_t number : usedNumbers)
+            {
+                ranges.push_back(state->bufferRecords[number]);
+                bufferIndexes.push_back(state->bufferIndexes[number]);
+            }
+
+            state->bufferIndexes.swap(bufferIndexes);
+            state->bufferRecords.clear();
+            state->fileSize = JOURNAL_HEADER_SIZE;
+            for (const std::pair<size_t, size_t> &range : ranges)
+            {
+                state->bufferRecords.emplace_back(state->fileSize, range.second);
+                state->fileSize += range.second;
+            }
+
+            std::vector<char> records;
+            journalWriteRecord(records, JOURNAL_CHECKPOINT, body);
+            state->fileSize += records.size();
+            written = state->file.rewrite(std::move(ranges), std::move(records));
+        }
+        else
+        {
+            written = state->write(JOURNAL_CHECKPOINT);
+        }
+
+        if (!written)
+        {
+            fail();
+        }
+    }
+
+    bool Journal::sync()
+    {
+        if (state == nullptr || !state->file.sync())
+        {
+            fail();
+            return false;
+        }
+        return true;
+    }
+
+    void Journal::close()
+    {
+        state.reset();
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace piece_table_detail
+{
+    // a buffer record in a journal file, offsets are relative to the start of the file
+    struct JournalBuffer
+    {
+        size_t recordOffset;
+        size_t recordSize;
+        size_t textOffset;
+        size_t length; // in characters
+    };
+
+    // what Journal::read found in a journal file, buffers are referred to by their position in buffers
+    struct JournalContent
+    {
+        std::vector<char> file;
+        size_t validLength; // the part of file that holds complete records
+        std::vector<JournalBuffer> buffers;
+        // buffer, start and end of every piece of the last checkpoint
+        std::vector<size_t> pieces;
+        // offset, removed length, first inserted buffer and inserted buffer count of every edit after it
+        std::vector<size_t> edits;
+    };
+
+    struct JournalState;
+
+    /**
+     * The edit journal of a table (see journal_file.hpp for the file format).
+     *
+     * The table refers to buffers by its own indexes. The journal numbers the buffers in its file in the order
+     * they are written and maps between both, so the buffers that are dropped when the file is compacted do not
+     * leave gaps that a recovery would have to fill.
+     *
+     * Only a pointer to the state, which lives in journal.cpp together with the background writer: a table that
+     * does not journal pays for one pointer and the users of the table do not include the threading headers.
+     * After an I/O error the journal closes itself, every write is ignored then.
+     */
+    class Journal
+    {
+        std::unique_ptr<JournalState> state;
+
+        void fail();
+
+    public:
+        Journal();
+        Journal(const Journal &other) = delete;
+        Journal &operator=(const Journal &other) = delete;
+        ~Journal();
+
+        bool isOpen() const;
+        bool hasEditsSinceCheckpoint() const;
+
+        /**
+         * Starts a new journal at path. The file (and the replacement of an existing one) is only created by the
+         * first checkpoint, together with the buffers written before it.
+         */
+        void create(const std::string &path, size_t charSize, size_t syncIntervalMs);
+        // reads the journal at path, false if it can not be read or holds no checkpoint
+        static bool read(const std::string &path, size_t charSize, JournalContent &content);
+        // continues the journal that was read into content, the table has to hold its buffers under their positions
+        bool resume(const std::string &path, size_t charSize, size_t syncIntervalMs, const JournalContent &content);
+
+        void writeBuffer(size_t bufferIndex, const void *text, size_t length);
+        void writeEdit(size_t offset, size_t removedLength, size_t firstBuffer, size_t bufferCount);
+        /**
+         * Writes the pieces (buffer index, start and end of each) as the new starting point of a recovery.
+         * Once the buffers no piece uses take as much space as the rest of the file, the writer thread replaces
+         * the file by the buffers that are used and the checkpoint.
+         */
+        void writeCheckpoint(const std::vector<size_t> &pieces);
+        // waits until everything written is on disk, false (and closed) if that failed
+        bool sync();
+        void close();
+    };
+}
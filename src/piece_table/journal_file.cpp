@@ -0,0 +1,378 @@
+#include "journal_file.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace piece_table_detail
+{
+    static const char JOURNAL_MAGIC[4] = {'B', 'D', 'J', '2'};
+    static_assert(JOURNAL_HEADER_SIZE == sizeof(JOURNAL_MAGIC) + 1, "the header is the magic and the character size");
+
+    static uint32_t journalChecksum(const char *data, size_t size)
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ uint8_t(data[i])) * 16777619u;
+        }
+        return hash;
+    }
+
+    static void journalWrite32(std::vector<char> &target, uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            target.push_back(char(value >> (8 * i)));
+        }
+    }
+
+    static uint32_t journalRead32(const char *data)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            value |= uint32_t(uint8_t(data[i])) << (8 * i);
+        }
+        return value;
+    }
+
+    void journalWriteNumber(std::vector<char> &body, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            body.push_back(char((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        body.push_back(char(value));
+    }
+
+    bool journalReadNumber(const char *&data, const char *end, uint64_t &value)
+    {
+        value = 0;
+        for (unsigned shift = 0; data != end && shift < 64; shift += 7)
+        {
+            uint8_t byte = uint8_t(*data++);
+            value |= uint64_t(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    bool readJournal(const std::string &path, size_t charSize, std::vector<char> &content, std::vector<JournalRecord> &records, size_t &validLength)
+    {
+        std::FILE *file = std::fopen(path.c_str(), "rb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        char chunk[1 << 16];
+        size_t readBytes;
+        while ((readBytes = std::fread(chunk, 1, sizeof(chunk), file)) != 0)
+        {
+            content.insert(content.end(), chunk, chunk + readBytes);
+        }
+        std::fclose(file);
+
+        if (content.size() < JOURNAL_HEADER_SIZE || std::memcmp(content.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 || size_t(uint8_t(content[sizeof(JOURNAL_MAGIC)])) != charSize)
+        {
+            return false;
+        }
+
+        size_t position = JOURNAL_HEADER_SIZE;
+        while (content.size() - position >= JOURNAL_FRAME_SIZE)
+        {
+            const char *frame = content.data() + position;
+            size_t bodySize = journalRead32(frame + 1);
+            if (content.size() - position - JOURNAL_FRAME_SIZE < bodySize || journalRead32(frame + 5 + bodySize) != journalChecksum(frame, 5 + bodySize))
+            {
+                break; // torn write
+            }
+
+            records.push_back(JournalRecord{JournalRecordType(uint8_t(frame[0])), frame + 5, bodySize});
+            position += JOURNAL_FRAME_SIZE + bodySize;
+        }
+
+        validLength = position;
+        return true;
+    }
+
+    static bool syncFile(std::FILE *file)
+    {
+        if (std::fflush(file) != 0)
+        {
+            return false;
+        }
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+
+    // makes a rename in the directory of path durable
+    static void syncDirectory(const std::string &path)
+    {
+#ifndef _WIN32
+        std::string directory = std::filesystem::path(path).parent_path().string();
+        int descriptor = open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+        if (descriptor >= 0)
+        {
+            fsync(descriptor);
+            ::close(descriptor);
+        }
+#endif
+    }
+
+    void journalWriteRecord(std::vector<char> &target, JournalRecordType type, const std::vector<char> &body)
+    {
+        size_t recordStart = target.size();
+        target.push_back(char(type));
+        journalWrite32(target, uint32_t(body.size()));
+        target.insert(target.end(), body.begin(), body.end());
+        journalWrite32(target, journalChecksum(target.data() + recordStart, target.size() - recordStart));
+    }
+
+    JournalFile::JournalFile(std::chrono::milliseconds syncInterval)
+        : charSize(0), syncInterval(syncInterval), file(nullptr), syncRequested(false),
+          stopping(false), failed(false), queuedCount(0), writtenCount(0) {}
+
+    JournalFile::~JournalFile()
+    {
+        close();
+    }
+
+    // writes the new journal next to the old one and renames it over it, so a crash leaves one of both complete
+    bool JournalFile::replaceFile(const std::vector<std::pair<size_t, size_t>> &ranges, const std::vector<char> &records)
+    {
+        std::string temporaryPath = path + ".tmp";
+        std::FILE *newFile = std::fopen(temporaryPath.c_str(), "wb");
+        if (newFile == nullptr)
+        {
+            return false;
+        }
+
+        char header[JOURNAL_HEADER_SIZE];
+        std::memcpy(header, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        header[sizeof(JOURNAL_MAGIC)] = char(charSize);
+        bool written = std::fwrite(header, 1, sizeof(header), newFile) == sizeof(header);
+
+        // the kept records are copied from the current file, the caller does not hold their text anymore
+        if (written && !ranges.empty())
+        {
+            std::FILE *oldFile = std::fopen(path.c_str(), "rb");
+            written = oldFile != nullptr;
+            std::vector<char> chunk(1 << 16);
+            for (size_t i = 0; i < ranges.size() && written; i++)
+            {
+                written = std::fseek(oldFile, long(ranges[i].first), SEEK_SET) == 0;
+                for (size_t copied = 0; copied < ranges[i].second && written; copied += chunk.size())
+                {
+                    size_t size = std::min(chunk.size(), ranges[i].second - copied);
+                    written = std::fread(chunk.data(), 1, size, oldFile) == size && std::fwrite(chunk.data(), 1, size, newFile) == size;
+                }
+            }
+            if (oldFile != nullptr)
+            {
+                std::fclose(oldFile);
+            }
+        }
+
+        written = written && std::fwrite(records.data(), 1, records.size(), newFile) == records.size() && syncFile(newFile);
+        written = std::fclose(newFile) == 0 && written;
+
+        std::error_code error;
+        if (written)
+        {
+            std::filesystem::rename(temporaryPath, path, error);
+        }
+        if (!written || error)
+        {
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+        syncDirectory(path);
+
+        if (file != nullptr)
+        {
+            std::fclose(file);
+        }
+        file = std::fopen(path.c_str(), "ab");
+        return file != nullptr;
+    }
+
+    bool JournalFile::appendToFile(const std::vector<char> &records)
+    {
+        return std::fwrite(records.data(), 1, records.size(), file) == records.size() && std::fflush(file) == 0;
+    }
+
+    void JournalFile::run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        std::chrono::steady_clock::time_point lastSync = std::chrono::steady_clock::now() - syncInterval;
+        while (true)
+        {
+            // group commit: everything queued until a sync interval passed since the last fsync shares one fsync
+            while (!stopping && !syncRequested)
+            {
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                bool hasRecords = !rewrites.empty() || !pending.empty();
+                if (hasRecords && now >= lastSync + syncInterval)
+                {
+                    break;
+                }
+                queued.wait_until(lock, hasRecords ? lastSync + syncInterval : now + std::chrono::hours(1));
+            }
+
+            std::vector<char> records;
+            std::vector<Rewrite> queuedRewrites;
+            records.swap(pending);
+            queuedRewrites.swap(rewrites);
+            bool stop = stopping;
+            bool succeeded = !failed;
+            uint64_t count = queuedCount;
+            syncRequested = false;
+            lock.unlock();
+
+            // the ranges of a rewrite refer to the file with everything queued before it
+            if (succeeded && !records.empty())
+                succeeded = appendToFile(records);
+            for (size_t i = 0; i < queuedRewrites.size() && succeeded; i++)
+                succeeded = replaceFile(queuedRewrites[i].ranges, queuedRewrites[i].records);
+            // a new file was synced before it was renamed
+            if (succeeded && !records.empty() && queuedRewrites.empty())
+                succeeded = syncFile(file);
+
+            lock.lock();
+            lastSync = std::chrono::steady_clock::now();
+            failed = failed || !succeeded;
+            writtenCount = count;
+            written.notify_all();
+            if (stop)
+            {
+                return;
+            }
+        }
+    }
+
+    bool JournalFile::create(const std::string &path, size_t charSize, const std::vector<char> &records)
+    {
+        close();
+        this->path = path;
+        this->charSize = charSize;
+        if (!replaceFile({}, records))
+        {
+            return false;
+        }
+
+        writer = std::thread(&JournalFile::run, this);
+        return true;
+    }
+
+    bool JournalFile::append(const std::string &path, size_t charSize, size_t validLength)
+    {
+        close();
+        this->path = path;
+        this->charSize = charSize;
+        std::error_code error;
+        std::filesystem::resize_file(path, validLength, error);
+        if (error)
+        {
+            return false;
+        }
+
+        file = std::fopen(path.c_str(), "ab");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        writer = std::thread(&JournalFile::run, this);
+        return true;
+    }
+
+    bool JournalFile::write(JournalRecordType type, const std::vector<char> &body)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (failed || !writer.joinable())
+        {
+            return false;
+        }
+
+        // the writer only sleeps without a deadline while there is nothing to write
+        bool idle = pending.empty() && rewrites.empty();
+        journalWriteRecord(rewrites.empty() ? pending : rewrites.back().records, type, body);
+        queuedCount++;
+        if (idle)
+        {
+            queued.notify_one();
+        }
+        return true;
+    }
+
+    bool JournalFile::rewrite(std::vector<std::pair<size_t, size_t>> ranges, std::vector<char> records)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (failed || !writer.joinable())
+        {
+            return false;
+        }
+
+        bool idle = pending.empty() && rewrites.empty();
+        rewrites.push_back(Rewrite{std::move(ranges), std::move(records)});
+        queuedCount++;
+        if (idle)
+        {
+            queued.notify_one();
+        }
+        return true;
+    }
+
+    bool JournalFile::sync()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (failed || !writer.joinable())
+        {
+            return false;
+        }
+
+        uint64_t count = queuedCount;
+        syncRequested = true;
+        queued.notify_one();
+        while (writtenCount < count)
+        {
+            written.wait_for(lock, syncInterval);
+        }
+        return !failed;
+    }
+
+    void JournalFile::close()
+    {
+        if (writer.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+                queued.notify_one();
+            }
+            writer.join();
+        }
+
+        if (file != nullptr)
+        {
+            std::fclose(file);
+            file = nullptr;
+        }
+        stopping = false;
+    }
+}
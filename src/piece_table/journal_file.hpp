@@ -0,0 +1,118 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace piece_table_detail
+{
+    /**
+     * The file format of the edit journal:
+     *
+     *   header:  "BDJ2" followed by one byte holding sizeof(CharType)
+     *   records: type (1 byte), body size (4 bytes), body, FNV-1a checksum of the previous fields (4 bytes)
+     *
+     * All numbers in record bodies are LEB128 varints. A record that is cut short or fails its checksum
+     * (a crash in the middle of a write) ends the journal.
+     *
+     * The buffers are numbered in the order their records appear in the file. The text of a buffer is written
+     * once, edits and checkpoints only refer to it by its number. A recovery starts at the last checkpoint.
+     * When the file is compacted it is replaced by the buffers the last checkpoint uses (renumbered in their
+     * order) and the checkpoint.
+     */
+    enum JournalRecordType : uint8_t
+    {
+        JOURNAL_BUFFER = 1,     // length, then the characters of the buffer
+        JOURNAL_EDIT = 2,       // offset, removed length, first inserted buffer, inserted buffer count
+        JOURNAL_CHECKPOINT = 3, // piece count, then buffer, start and end of every piece
+    };
+
+    constexpr size_t JOURNAL_HEADER_SIZE = 5;
+    constexpr size_t JOURNAL_FRAME_SIZE = 1 + 4 + 4; // type, body size, checksum
+
+    struct JournalRecord
+    {
+        JournalRecordType type;
+        const char *body;
+        size_t size;
+    };
+
+    void journalWriteNumber(std::vector<char> &body, uint64_t value);
+    bool journalReadNumber(const char *&data, const char *end, uint64_t &value);
+    // appends a complete record (header, body and checksum) to target
+    void journalWriteRecord(std::vector<char> &target, JournalRecordType type, const std::vector<char> &body);
+
+    /**
+     * Reads the journal at path into content and splits it into records.
+     * validLength is set to the length of the part of the file that holds complete records.
+     * Returns false if the file can not be read or was not written for characters of charSize bytes.
+     */
+    bool readJournal(const std::string &path, size_t charSize, std::vector<char> &content, std::vector<JournalRecord> &records, size_t &validLength);
+
+    /**
+     * Appends records to a journal file from a background thread, so an edit never waits for the disk.
+     *
+     * Group commit: the thread writes everything that was queued and fsyncs it at most once per
+     * syncInterval, so a record is on disk at most about syncInterval (plus the duration of one write)
+     * after it was queued. After an I/O error nothing is written anymore and every call returns false.
+     */
+    class JournalFile
+    {
+        // replaces the file by the ranges of it, records and the records queued after the rewrite
+        struct Rewrite
+        {
+            std::vector<std::pair<size_t, size_t>> ranges;
+            std::vector<char> records;
+        };
+
+        std::string path;
+        size_t charSize;
+        std::chrono::milliseconds syncInterval;
+        std::FILE *file;
+        std::thread writer;
+
+        std::mutex mutex;
+        std::condition_variable queued;
+        std::condition_variable written;
+        std::vector<char> pending;     // records for the current file
+        std::vector<Rewrite> rewrites; // done in order after pending was written
+        bool syncRequested;
+        bool stopping;
+        bool failed;
+        uint64_t queuedCount;
+        uint64_t writtenCount;
+
+        bool replaceFile(const std::vector<std::pair<size_t, size_t>> &ranges, const std::vector<char> &records);
+        bool appendToFile(const std::vector<char> &records);
+        void run();
+
+    public:
+        explicit JournalFile(std::chrono::milliseconds syncInterval);
+        JournalFile(const JournalFile &other) = delete;
+        JournalFile &operator=(const JournalFile &other) = delete;
+        ~JournalFile();
+
+        // starts a new journal holding records, an existing file is replaced atomically
+        bool create(const std::string &path, size_t charSize, const std::vector<char> &records);
+        // continues a journal after its first validLength bytes, anything after them is dropped
+        bool append(const std::string &path, size_t charSize, size_t validLength);
+        // queues a record
+        bool write(JournalRecordType type, const std::vector<char> &body);
+        /**
+         * Queues replacing the file by a new one, atomically. It starts with the ranges (offset and size) of
+         * the file as it is when all records queued before are written, followed by records (written with
+         * journalWriteRecord) and the records queued after this call.
+         */
+        bool rewrite(std::vector<std::pair<size_t, size_t>> ranges, std::vector<char> records);
+        // waits until everything queued is on disk
+        bool sync();
+        // writes everything queued and closes the file
+        void close();
+    };
+}
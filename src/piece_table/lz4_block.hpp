@@ -0,0 +1,157 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace piece_table_detail
+{
+    /**
+     * A small implementation of the LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md).
+     * Every block is compressed and decompressed on its own, the uncompressed size is stored by the caller.
+     */
+    constexpr size_t LZ4_MIN_MATCH = 4;
+    constexpr size_t LZ4_LAST_LITERALS = 5;  // the last 5 bytes are always literals
+    constexpr size_t LZ4_MATCH_LIMIT = 12;   // no match may start in the last 12 bytes
+    constexpr size_t LZ4_MAX_OFFSET = 65535;
+    constexpr unsigned LZ4_HASH_BITS = 12;
+
+    inline uint32_t lz4Read32(const unsigned char *data)
+    {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    inline uint32_t lz4Hash(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+    }
+
+    template <typename Output>
+    void lz4WriteLength(Output &output, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            output.push_back(char(255));
+        }
+        output.push_back(char(length));
+    }
+
+    template <typename Output>
+    void lz4WriteSequence(Output &output, const unsigned char *literals, size_t literalLength, size_t offset, size_t matchLength)
+    {
+        size_t matchCode = matchLength == 0 ? 0 : matchLength - LZ4_MIN_MATCH;
+        output.push_back(char(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15)));
+        if (literalLength >= 15)
+            lz4WriteLength(output, literalLength - 15);
+        output.insert(output.end(), literals, literals + literalLength);
+
+        if (matchLength == 0)
+            return; // the last sequence has no match
+
+        output.push_back(char(offset & 0xFF));
+        output.push_back(char(offset >> 8));
+        if (matchCode >= 15)
+            lz4WriteLength(output, matchCode - 15);
+    }
+
+    // appends the compressed form of [data, data + size) to output (a vector of char)
+    template <typename Output>
+    void lz4Compress(const unsigned char *data, size_t size, Output &output)
+    {
+        size_t anchor = 0;
+        if (size > LZ4_MATCH_LIMIT)
+        {
+            const uint32_t EMPTY = UINT32_MAX;
+            uint32_t table[size_t(1) << LZ4_HASH_BITS];
+            std::fill(table, table + (size_t(1) << LZ4_HASH_BITS), EMPTY);
+
+            size_t position = 0;
+            while (position < size - LZ4_MATCH_LIMIT)
+            {
+                uint32_t sequence = lz4Read32(data + position);
+                uint32_t &slot = table[lz4Hash(sequence)];
+                size_t reference = slot;
+                slot = uint32_t(position);
+
+                if (reference == EMPTY || position - reference > LZ4_MAX_OFFSET || lz4Read32(data + reference) != sequence)
+                {
+                    position++;
+                    continue;
+                }
+
+                size_t matchLength = LZ4_MIN_MATCH;
+                while (position + matchLength < size - LZ4_LAST_LITERALS && data[reference + matchLength] == data[position + matchLength])
+                {
+                    matchLength++;
+                }
+                while (position > anchor && reference > 0 && data[position - 1] == data[reference - 1])
+                {
+                    position--, reference--, matchLength++;
+                }
+
+                lz4WriteSequence(output, data + anchor, position - anchor, position - reference, matchLength);
+                position += matchLength;
+                anchor = position;
+            }
+        }
+
+        lz4WriteSequence(output, data + anchor, size - anchor, 0, 0);
+    }
+
+    // returns false if the input is not a valid block that decompresses to exactly size bytes
+    inline bool lz4Decompress(const unsigned char *input, size_t inputSize, unsigned char *data, size_t size)
+    {
+        const unsigned char *inputEnd = input + inputSize;
+        size_t written = 0;
+
+        auto readLength = [&](size_t length) -> size_t
+        {
+            if (length != 15)
+                return length;
+            unsigned char byte;
+            do
+            {
+                if (input == inputEnd)
+                    return SIZE_MAX;
+                byte = *input++;
+                length += byte;
+            } while (byte == 255);
+            return length;
+        };
+
+        while (input != inputEnd)
+        {
+            unsigned char token = *input++;
+
+            size_t literalLength = readLength(token >> 4);
+            if (literalLength > size_t(inputEnd - input) || literalLength > size - written)
+                return false;
+            std::memcpy(data + written, input, literalLength);
+            input += literalLength;
+            written += literalLength;
+
+            if (input == inputEnd)
+                break; // the last sequence has no match
+
+            if (inputEnd - input < 2)
+                return false;
+            size_t offset = size_t(input[0]) | (size_t(input[1]) << 8);
+            input += 2;
+
+            size_t matchLength = readLength(token & 0x0F);
+            if (matchLength == SIZE_MAX || offset == 0 || offset > written || matchLength + LZ4_MIN_MATCH > size - written)
+                return false;
+            matchLength += LZ4_MIN_MATCH;
+
+            // byte by byte, the match may overlap the bytes it writes
+            for (size_t i = 0; i < matchLength; i++, written++)
+            {
+                data[written] = data[written - offset];
+            }
+        }
+
+        return written == size;
+    }
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace piece_table_detail
+{
+    /**
+     * Myers' O((n + m) * d) diff of two sequences of length n and m.
+     * equal(i, j) has to tell whether the i-th element of the first sequence equals the j-th of the second.
+     *
+     * On success matches holds the pairs (i, j) of a longest common subsequence in increasing order.
+     * Returns false (and leaves matches empty) if the sequences need more than maxEdits insertions and
+     * deletions, this keeps the O(d^2) memory of the search bounded.
+     */
+    template <typename Equal>
+    bool myersDiff(size_t n, size_t m, Equal equal, size_t maxEdits, std::vector<std::pair<size_t, size_t>> &matches)
+    {
+        using Index = std::ptrdiff_t;
+        const Index N = Index(n), M = Index(m);
+        const Index UNREACHABLE = -1;
+
+        // the furthest x on diagonal k = x - y that one more edit reaches from the previous round,
+        // previousK is set to the diagonal the edit came from
+        auto step = [N, M, UNREACHABLE](const std::vector<Index> &previous, Index d, Index k, Index &previousK) -> Index
+        {
+            Index down = UNREACHABLE, right = UNREACHABLE;
+            if (k + 1 <= d - 1 && previous[k + 1 + d - 1] != UNREACHABLE && previous[k + 1 + d - 1] - k <= M)
+                down = previous[k + 1 + d - 1];
+            if (k - 1 >= -(d - 1) && previous[k - 1 + d - 1] != UNREACHABLE && previous[k - 1 + d - 1] + 1 <= N)
+                right = previous[k - 1 + d - 1] + 1;
+
+            previousK = down >= right ? k + 1 : k - 1;
+            return std::max(down, right);
+        };
+
+        // trace[d][k + d] is the furthest x reached on diagonal k with d edits
+        std::vector<std::vector<Index>> trace;
+        Index x = 0, y = 0;
+        while (x < N && y < M && equal(size_t(x), size_t(y)))
+        {
+            x++, y++;
+        }
+        trace.emplace_back(1, x);
+
+        Index d = 0;
+        bool done = x >= N && y >= M;
+        while (!done)
+        {
+            d++;
+            if (size_t(d) > maxEdits)
+            {
+                return false;
+            }
+
+            std::vector<Index> current(2 * d + 1, UNREACHABLE);
+            for (Index k = -d; k <= d && !done; k += 2)
+            {
+                Index previousK;
+                x = step(trace.back(), d, k, previousK);
+                if (x == UNREACHABLE)
+                    continue;
+
+                y = x - k;
+                while (x < N && y < M && equal(size_t(x), size_t(y)))
+                {
+                    x++, y++;
+                }
+                current[k + d] = x;
+                done = x >= N && y >= M;
+            }
+            trace.push_back(std::move(current));
+        }
+
+        // walk the trace backwards and collect the diagonal (matching) moves
+        x = N, y = M;
+        for (; d > 0; d--)
+        {
+            Index k = x - y;
+            Index previousK;
+            Index snakeStartX = step(trace[d - 1], d, k, previousK);
+            while (x > snakeStartX)
+            {
+                x--, y--;
+                matches.emplace_back(size_t(x), size_t(y));
+            }
+
+            x = trace[d - 1][previousK + d - 1];
+            y = x - previousK;
+        }
+        while (x > 0)
+        {
+            x--, y--;
+            matches.emplace_back(size_t(x), size_t(y));
+        }
+
+        std::reverse(matches.begin(), matches.end());
+        return true;
+    }
+
+    /**
+     * The longest subsequence of candidates, pairs (i, j) with increasing i, whose j increase as well, found by
+     * patience sorting in O(k log k). Keeps the anchors of a diff that are in the same order in both sequences.
+     */
+    inline std::vector<std::pair<size_t, size_t>> increasingMatches(const std::vector<std::pair<size_t, size_t>> &candidates)
+    {
+        const size_t NONE = size_t(-1);
+        // tails[l] is the candidate with the smallest j that ends an increasing subsequence of length l + 1
+        std::vector<size_t> tails, previous(candidates.size());
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            auto tail = std::lower_bound(tails.begin(), tails.end(), candidates[i].second, [&](size_t candidate, size_t j)
+                                         { return candidates[candidate].second < j; });
+            previous[i] = tail == tails.begin() ? NONE : *(tail - 1);
+            if (tail == tails.end())
+                tails.push_back(i);
+            else
+                *tail = i;
+        }
+
+        std::vector<std::pair<size_t, size_t>> matches;
+        for (size_t i = tails.empty() ? NONE : tails.back(); i != NONE; i = previous[i])
+        {
+            matches.push_back(candidates[i]);
+        }
+        std::reverse(matches.begin(), matches.end());
+        return matches;
+    }
+}
@@ -1,41 +1,290 @@
 #pragma once
-#include <deque>
-#include <iostream>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
-class PieceTable
+#include "journal.hpp"
+#include "lz4_block.hpp"
+#include "myers_diff.hpp"
+
+/**
+ * Compile time configuration of a BasicPieceTable.
+ *
+ * To tune the table for a specific use derive from this struct and shadow the
+ * members you want to change, e.g.
+ *
+ *   struct LogViewerTraits : PieceTableTraits<char>
+ *   {
+ *       static constexpr size_t MAX_CHAR_PER_NODE = 64 * 1024;
+ *   };
+ *
+ * Every optional feature that is turned off costs neither memory in the nodes
+ * and buffers nor time during edits.
+ */
+template <typename CharT = char>
+struct PieceTableTraits
 {
-private:
-    const size_t MAX_CHAR_PER_NODE = 200;
-    enum Color
-    {
-        RED,
-        BLACK
-    };
+    using CharType = CharT;
+    using Allocator = std::allocator<CharT>;
+
+    // the maximal number of characters a single piece (and a single buffer) may hold
+    static constexpr size_t MAX_CHAR_PER_NODE = 200;
+    // keep line start indexes per buffer and line counts per subtree (needed by getLineContent)
+    static constexpr bool TRACK_LINES = true;
+    // keep the number of UTF-16 code units per subtree (needed by getUtf16Length)
+    static constexpr bool TRACK_UTF16 = false;
+    // keep a polynomial hash per subtree (needed by getHash and getCommonPrefixLength)
+    static constexpr bool TRACK_HASH = false;
+    // keep buffers that were not read for a while LZ4 compressed, only the HOT_BUFFER_COUNT most recently
+    // used buffers are kept decompressed. Every buffer is compressed as one block, so MAX_CHAR_PER_NODE is
+    // the block size: worth it with a few kilobytes or more. With the default of 200 characters, and for
+    // the buffers of typed text (every insert gets its own) below 64 characters, nothing is saved
+    static constexpr bool COMPRESS_BUFFERS = false;
+    static constexpr size_t HOT_BUFFER_COUNT = 16;
+    // while a journal is attached, a background thread writes the edits and fsyncs them at most this often,
+    // so a crash loses about the last interval of edits
+    static constexpr size_t JOURNAL_SYNC_INTERVAL_MS = 50;
+};
+
+namespace piece_table_detail
+{
+    template <bool TrackLines>
     struct BufferPosition
     {
         size_t index;
         size_t offset;
 
         BufferPosition() = default;
-        BufferPosition(const BufferPosition &other);
-        BufferPosition(size_t index, size_t offset);
-        BufferPosition &operator=(const BufferPosition &other);
+        BufferPosition(size_t index, size_t offset) : index(index), offset(offset) {}
+    };
+    template <>
+    struct BufferPosition<false>
+    {
+        size_t offset;
+
+        BufferPosition() = default;
+        explicit BufferPosition(size_t offset) : offset(offset) {}
     };
-    struct EditPiece
+
+    template <bool TrackLines>
+    struct LineMetadata
+    {
+        size_t leftSubTreeLineCount = 0;
+    };
+    template <>
+    struct LineMetadata<false>
+    {
+    };
+
+    template <bool TrackUtf16>
+    struct Utf16Metadata
+    {
+        size_t utf16Length = 0;
+        size_t leftSubTreeUtf16Length = 0;
+    };
+    template <>
+    struct Utf16Metadata<false>
+    {
+    };
+
+    template <bool TrackHash>
+    struct HashMetadata
+    {
+        uint64_t hash = 0;           // hash of the piece itself
+        uint64_t subTreeHash = 0;    // hash of the whole subtree rooted at the node
+        uint64_t subTreePower = 1;   // HASH_BASE ^ (length of the subtree)
+    };
+    template <>
+    struct HashMetadata<false>
+    {
+    };
+
+    template <bool TrackHash, typename HashAllocator>
+    struct SnapshotHashes
+    {
+        // hash of the document up to the end of every span
+        std::vector<uint64_t, HashAllocator> prefixHashes;
+
+        explicit SnapshotHashes(const HashAllocator &allocator) : prefixHashes(allocator) {}
+    };
+    template <typename HashAllocator>
+    struct SnapshotHashes<false, HashAllocator>
+    {
+        explicit SnapshotHashes(const HashAllocator &) {}
+    };
+
+    template <bool Compress, typename CharAllocator>
+    struct BufferCompression
+    {
+        size_t length;
+        // the compressed text, empty until the buffer gets cold for the first time or if it does not compress
+        mutable std::vector<char, CharAllocator> compressed;
+        mutable uint64_t lastUse = 0;
+
+        BufferCompression(size_t length, const CharAllocator &allocator) : length(length), compressed(allocator) {}
+    };
+    template <typename CharAllocator>
+    struct BufferCompression<false, CharAllocator>
+    {
+        BufferCompression(size_t, const CharAllocator &) {}
+    };
+
+    // the buffers that are currently decompressed, in no particular order
+    template <bool Compress>
+    struct HotBuffers
+    {
+        mutable std::vector<size_t> hotBuffers;
+        mutable uint64_t bufferClock = 0;
+    };
+    template <>
+    struct HotBuffers<false>
+    {
+    };
+
+    template <bool TrackLines, typename SizeAllocator>
+    struct BufferLineStarts
+    {
+        std::vector<size_t, SizeAllocator> lineStarts;
+
+        explicit BufferLineStarts(const SizeAllocator &allocator) : lineStarts(allocator) {}
+    };
+    template <typename SizeAllocator>
+    struct BufferLineStarts<false, SizeAllocator>
+    {
+        explicit BufferLineStarts(const SizeAllocator &) {}
+    };
+
+    // number of UTF-16 code units needed to encode the given UTF-8/16/32 text
+    template <typename CharT>
+    size_t countUtf16Units(const CharT *first, const CharT *last)
+    {
+        size_t count = 0;
+        if constexpr (sizeof(CharT) == 2)
+        {
+            count = last - first;
+        }
+        else if constexpr (sizeof(CharT) == 1)
+        {
+            for (; first != last; first++)
+            {
+                unsigned char byte = static_cast<unsigned char>(*first);
+                if ((byte & 0xC0) != 0x80) // continuation bytes belong to the previous code point
+                    count += byte >= 0xF0 ? 2 : 1;
+            }
+        }
+        else
+        {
+            for (; first != last; first++)
+            {
+                count += static_cast<unsigned long>(*first) > 0xFFFF ? 2 : 1;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * Polynomial hash modulo the mersenne prime 2^61 - 1:
+     *   hash(s) = s[0] * B^(n-1) + s[1] * B^(n-2) + ... + s[n-1]
+     * so the hash of a concatenation is hash(a) * B^|b| + hash(b).
+     */
+    constexpr uint64_t HASH_MOD = (uint64_t(1) << 61) - 1;
+    constexpr uint64_t HASH_BASE = 0x1F3D5B79A2C4E68Bull % HASH_MOD;
+
+    inline uint64_t hashReduce(uint64_t value)
+    {
+        value = (value >> 61) + (value & HASH_MOD);
+        return value >= HASH_MOD ? value - HASH_MOD : value;
+    }
+
+    // portable (no 128 bit integers) multiplication of two values below 2^61
+    inline uint64_t hashMultiply(uint64_t a, uint64_t b)
+    {
+        const uint64_t MASK30 = (uint64_t(1) << 30) - 1;
+        const uint64_t MASK31 = (uint64_t(1) << 31) - 1;
+        uint64_t aHigh = a >> 31, aLow = a & MASK31;
+        uint64_t bHigh = b >> 31, bLow = b & MASK31;
+        uint64_t middle = aLow * bHigh + aHigh * bLow;
+        return hashReduce(aHigh * bHigh * 2 + (middle >> 30) + ((middle & MASK30) << 31) + aLow * bLow);
+    }
+
+    inline uint64_t hashPower(size_t exponent)
+    {
+        uint64_t result = 1, base = HASH_BASE;
+        for (; exponent != 0; exponent >>= 1)
+        {
+            if (exponent & 1)
+                result = hashMultiply(result, base);
+            base = hashMultiply(base, base);
+        }
+        return result;
+    }
+
+    // hash of the concatenation of two texts given the hash of each and B^|right|
+    inline uint64_t hashConcat(uint64_t leftHash, uint64_t rightHash, uint64_t rightPower)
+    {
+        return hashReduce(hashMultiply(leftHash, rightPower) + rightHash);
+    }
+
+    template <typename CharT>
+    uint64_t hashText(const CharT *first, const CharT *last)
+    {
+        using Unsigned = std::make_unsigned_t<CharT>;
+        uint64_t hash = 0;
+        for (; first != last; first++)
+        {
+            hash = hashConcat(hash, uint64_t(Unsigned(*first)) + 1, HASH_BASE);
+        }
+        return hash;
+    }
+}
+
+template <typename Traits>
+class BasicPieceTable : private piece_table_detail::HotBuffers<Traits::COMPRESS_BUFFERS>
+{
+public:
+    using CharType = typename Traits::CharType;
+    using Allocator = typename Traits::Allocator;
+    using String = std::basic_string<CharType, std::char_traits<CharType>, Allocator>;
+
+    static constexpr size_t MAX_CHAR_PER_NODE = Traits::MAX_CHAR_PER_NODE;
+    static constexpr bool TRACK_LINES = Traits::TRACK_LINES;
+    static constexpr bool TRACK_UTF16 = Traits::TRACK_UTF16;
+    static constexpr bool TRACK_HASH = Traits::TRACK_HASH;
+    static constexpr bool COMPRESS_BUFFERS = Traits::COMPRESS_BUFFERS;
+    static constexpr size_t HOT_BUFFER_COUNT = Traits::HOT_BUFFER_COUNT;
+    static constexpr size_t JOURNAL_SYNC_INTERVAL_MS = Traits::JOURNAL_SYNC_INTERVAL_MS;
+
+    static_assert(MAX_CHAR_PER_NODE > 0, "a piece must be able to hold at least one character");
+    static_assert(!COMPRESS_BUFFERS || HOT_BUFFER_COUNT >= 2, "the text of two buffers is needed at the same time when comparing");
+
+private:
+    template <typename T>
+    using Rebind = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+
+    enum Color
+    {
+        RED,
+        BLACK
+    };
+    using BufferPosition = piece_table_detail::BufferPosition<TRACK_LINES>;
+    struct EditPiece : piece_table_detail::LineMetadata<TRACK_LINES>, piece_table_detail::Utf16Metadata<TRACK_UTF16>, piece_table_detail::HashMetadata<TRACK_HASH>
     {
         size_t bufferInfex;
         BufferPosition start;
         BufferPosition end;
 
         size_t leftSubTreeLength;
-        size_t leftSubTreeLineCount;
 
         EditPiece() = default;
-        EditPiece(const EditPiece &other);
-        EditPiece &operator=(const EditPiece &other);
         EditPiece(const size_t bufferInfex, const BufferPosition &start, const BufferPosition &end);
     };
     struct EditNode
@@ -47,22 +296,14 @@ private:
         EditNode *left;
         EditNode *right;
 
-        EditNode(EditPiece &data);
         EditNode(const EditPiece &data);
-        EditNode &operator=(const EditNode &other);
-        ~EditNode();
     };
-    struct Buffer
+    struct Buffer : piece_table_detail::BufferLineStarts<TRACK_LINES, Rebind<size_t>>, piece_table_detail::BufferCompression<COMPRESS_BUFFERS, Rebind<char>>
     {
-        std::string str;
-        size_t *lineStarts;
-        size_t lineCount;
-
-        Buffer(std::string str);
-        Buffer(const Buffer &other);
-        ~Buffer();
+        // empty while the buffer is compressed, always read through getBufferText
+        mutable String str;
 
-        Buffer &operator=(const Buffer &other);
+        Buffer(const CharType *data, size_t length, const Allocator &allocator);
     };
     struct NodePosition
     {
@@ -71,47 +312,257 @@ private:
 
         NodePosition(size_t nodeStartOffset, EditNode *node);
     };
-    struct NodeArrayStruct
+    // characters [start, end) of a buffer, the unit in which two documents are compared
+    struct PieceSpan
+    {
+        size_t bufferInfex;
+        size_t start;
+        size_t end;
+    };
+    using NodeAllocator = Rebind<EditNode>;
+    using PieceList = std::vector<EditPiece, Rebind<EditPiece>>;
+    using SpanList = std::vector<PieceSpan, Rebind<PieceSpan>>;
+    // walks the spans of a snapshot or the pieces of a table, from the start or from the end
+    struct SpanCursor
+    {
+        const BasicPieceTable *table;
+        const SpanList *spans; // nullptr to walk the pieces of the table
+        bool fromEnd;
+        size_t spanIndex;
+        EditNode *node;
+
+        SpanCursor(const BasicPieceTable *table, const SpanList *spans, bool fromEnd);
+        bool next(PieceSpan &span);
+    };
+
+    // smaller buffers are never compressed
+    static constexpr size_t MIN_COMPRESSED_BUFFER_SIZE = 64;
+
+    // bound the O(d^2) memory of the character diff between two anchors, a bigger change of text without lines
+    // to anchor on is reported as one range
+    static constexpr size_t MAX_CHAR_DIFF_EDITS = 512;
+
+public:
+    // the range [oldIndex, oldIndex + oldLength) of the older document was replaced by [newIndex, newIndex + newLength)
+    struct DiffRange
+    {
+        size_t oldIndex;
+        size_t oldLength;
+        size_t newIndex;
+        size_t newLength;
+    };
+    using DiffList = std::vector<DiffRange, Rebind<DiffRange>>;
+
+    // the memory held by the text of the buffers
+    struct BufferStatistics
+    {
+        size_t textBytes;         // decompressed text, of the hot buffers and those that do not compress
+        size_t compressedBytes;   // compressed blocks, kept while the buffer is hot as well
+        size_t compressedBuffers; // buffers that have a compressed block
+    };
+
+    /**
+     * The content of a table at the time takeSnapshot was called.
+     * A snapshot only references the buffers of its table (which are never changed or freed),
+     * so it is cheap to keep but must not outlive the table.
+     */
+    class Snapshot : private piece_table_detail::SnapshotHashes<TRACK_HASH, Rebind<uint64_t>>
+    {
+        friend class BasicPieceTable;
+
+        const BasicPieceTable *table;
+        SpanList spans;
+        // the document offset every span ends at
+        std::vector<size_t, Rebind<size_t>> offsets;
+
+        explicit Snapshot(const BasicPieceTable *table);
+    };
+
+    /**
+     * One edit: removedLength characters at offset were replaced by insertedLength characters.
+     * The line fields are only filled when the traits enable TRACK_LINES: lines [startLine, oldEndLine]
+     * of the document before the edit became lines [startLine, newEndLine].
+     */
+    struct ChangeEvent
+    {
+        size_t offset;
+        size_t removedLength;
+        size_t insertedLength;
+        size_t startLine;
+        size_t oldEndLine;
+        size_t newEndLine;
+    };
+    using ChangeList = std::vector<ChangeEvent, Rebind<ChangeEvent>>;
+
+    /**
+     * Collects the edits made to a table from its construction on, until they are taken.
+     * Edits that touch each other are merged into one event, so a consumer that takes the events once
+     * per frame (or per keystroke batch) gets a short list of regions to redo.
+     * The stream detaches itself from the table when either of them is destroyed.
+     */
+    class ChangeStream
     {
-        EditPiece *pieces;
-        size_t size;
-        NodeArrayStruct();
-        NodeArrayStruct(const NodeArrayStruct &other);
-        NodeArrayStruct(size_t size);
-        ~NodeArrayStruct();
+        friend class BasicPieceTable;
+
+        BasicPieceTable *table;
+        ChangeStream *next;
+        ChangeList pending;
+
+        void push(const ChangeEvent &event);
+
+    public:
+        explicit ChangeStream(BasicPieceTable &table);
+        ChangeStream(const ChangeStream &other) = delete;
+        ChangeStream &operator=(const ChangeStream &other) = delete;
+        ~ChangeStream();
+
+        bool empty() const;
+        // the events since the last call, in the order they were made
+        ChangeList take();
     };
 
+private:
+    NodeAllocator nodeAllocator;
     EditNode *editTreeRoot;
-    std::vector<Buffer> buffers;
-
-    void change(const size_t index, const size_t length, const std::string &data);
-    size_t insertBuffer(const std::string &data);
-    // void insertEdit(EditNode data);
-    NodePosition nodeAt(size_t index);
-    size_t getEditPieceLength(const EditPiece &piece);
-    size_t getEditPieceLineCount(const EditPiece &piece);
+    std::vector<Buffer, Rebind<Buffer>> buffers;
+    ChangeStream *changeStreams; // the first of a list linked through ChangeStream::next
+    piece_table_detail::Journal journal;
+
+    void change(size_t index, size_t length, const String &data);
+    void insertPieces(const size_t index, const PieceList &x);
+    void removePieces(const size_t index, const size_t length);
+    size_t insertBuffer(const CharType *data, size_t length);
+    const String &getBufferText(size_t bufferIndex) const;
+    void addHotBuffer(size_t bufferIndex) const;
+    void evictHotBuffer(size_t position) const;
+    NodePosition nodeAt(size_t index) const;
+    size_t toBufferOffset(const Buffer &buffer, const BufferPosition &position) const;
+    BufferPosition toBufferPosition(const Buffer &buffer, size_t offset) const;
+    size_t getEditPieceLength(const EditPiece &piece) const;
+    size_t getEditPieceLineCount(const EditPiece &piece) const;
+    size_t getEditPieceUtf16Length(const EditPiece &piece) const;
+    uint64_t getEditPieceHash(const EditPiece &piece, size_t from, size_t to) const;
+    EditNode *createNode(const EditPiece &piece);
+    void destroyNode(EditNode *node);
+    void destroyTree(EditNode *node);
+    void removeNode(EditNode *node);
+    void fixRemove(EditNode *node, EditNode *parent);
     EditNode *insertRight(EditNode *const node, const EditPiece &piece);
     EditNode *insertLeft(EditNode *const node, const EditPiece &piece);
-    EditNode *findSmallest(EditNode *node);
-    EditNode *findBiggest(EditNode *node);
+    EditNode *findSmallest(EditNode *node) const;
+    EditNode *findBiggest(EditNode *node) const;
     void fixInsert(EditNode *node);
-    void updateMetadata(EditNode *node);
+    void updateMetadata(EditNode *node, const EditPiece &piece, bool removed);
+    void updateHash(EditNode *node);
+    void updateSubTreeHash(EditNode *node);
     void rotateRight(EditNode *node);
     void rotateLeft(EditNode *node);
-    size_t calculateLength(EditNode *node);
-    size_t calculateLineCount(EditNode *node);
-    NodeArrayStruct createPieces(const std::string &data);
+    size_t calculateLength(EditNode *node) const;
+    size_t calculateLineCount(EditNode *node) const;
+    size_t calculateUtf16Length(EditNode *node) const;
+    PieceList createPieces(const String &data);
+    EditPiece createPiece(size_t bufferIndex, size_t start, size_t end) const;
     void splitNode(EditNode *const node, size_t offset);
-    EditNode *getNextNode(EditNode *node);
-    std::string getEditPieceText(EditPiece &piece);
-    std::string getEditPieceTextTillEndLine(EditPiece &piece);
+    void splitAt(size_t index);
+    EditNode *getNextNode(EditNode *node) const;
+    EditNode *getPreviousNode(EditNode *node) const;
+    template <bool Enabled = TRACK_LINES, typename = std::enable_if_t<Enabled>>
+    size_t getLineStartOffset(size_t line) const;
+    template <bool Enabled = TRACK_LINES, typename = std::enable_if_t<Enabled>>
+    size_t getLineAt(size_t index) const;
+    template <bool Enabled = TRACK_HASH, typename = std::enable_if_t<Enabled>>
+    uint64_t calculatePrefixHash(size_t length) const;
+    void appendEditPieceText(String &target, const EditPiece &piece, size_t from, size_t to) const;
+    template <bool Enabled = TRACK_HASH, typename = std::enable_if_t<Enabled>>
+    uint64_t calculateSnapshotPrefixHash(const Snapshot &snapshot, size_t length) const;
+    template <typename Equal>
+    static size_t searchCommonLength(size_t maxLength, Equal equalPrefix);
+    template <typename OlderPrefixHash>
+    void findCommonEnds(size_t olderLength, OlderPrefixHash olderPrefixHash, size_t &prefix, size_t &suffix) const;
+    void findCommonEnds(SpanCursor olderFront, SpanCursor olderBack, size_t olderLength, size_t &prefix, size_t &suffix) const;
+    static size_t getCommonLength(SpanCursor older, SpanCursor newer, size_t limit);
+    SpanList getSpans(size_t from, size_t to) const;
+    static SpanList getSnapshotSpans(const Snapshot &snapshot, size_t from, size_t to);
+    static void splitSharedSpans(SpanList &older, SpanList &newer);
+    static size_t getLineEnd(const CharType *text, size_t length, size_t start);
+    static std::vector<std::pair<size_t, size_t>> getUniqueLineMatches(const CharType *older, size_t olderLength, const CharType *newer, size_t newerLength);
+    static void diffText(const CharType *older, size_t olderLength, const CharType *newer, size_t newerLength, size_t olderOffset, size_t newerOffset, DiffList &changes);
+    static String getSpansText(const BasicPieceTable &table, const SpanList &spans, size_t from, size_t to);
+    static DiffList diffSpans(const BasicPieceTable &olderTable, SpanList older, const BasicPieceTable &newerTable, SpanList newer, size_t offset);
+    void writeJournalCheckpoint(const SpanList &spans);
 
 public:
-    PieceTable();
-    ~PieceTable();
-
-    PieceTable &insert(const size_t index, const std::string &data);
-    PieceTable &remove(const size_t index, const size_t &length);
-    PieceTable &replace(const size_t index, const size_t &length, const std::string &data);
-    std::string getLineContent(size_t line);
-};
\ No newline at end of file
+    explicit BasicPieceTable(const Allocator &allocator = Allocator());
+    BasicPieceTable(const BasicPieceTable &other) = delete;
+    BasicPieceTable &operator=(const BasicPieceTable &other) = delete;
+    ~BasicPieceTable();
+
+    BasicPieceTable &insert(const size_t index, const String &data);
+    BasicPieceTable &remove(const size_t index, const size_t &length);
+    BasicPieceTable &replace(const size_t index, const size_t &length, const String &data);
+    size_t getLength() const;
+    // compresses every buffer now instead of waiting for it to get cold, e.g. when the document becomes idle
+    void compressBuffers();
+    // only available when the traits enable COMPRESS_BUFFERS, O(buffers)
+    template <bool Enabled = COMPRESS_BUFFERS, typename = std::enable_if_t<Enabled>>
+    BufferStatistics getBufferStatistics() const;
+    String getText() const;
+    String getText(size_t index, size_t length) const;
+
+    // only available when the traits enable TRACK_LINES
+    template <bool Enabled = TRACK_LINES, typename = std::enable_if_t<Enabled>>
+    size_t getLineCount() const;
+    template <bool Enabled = TRACK_LINES, typename = std::enable_if_t<Enabled>>
+    String getLineContent(size_t line) const;
+
+    // only available when the traits enable TRACK_UTF16
+    template <bool Enabled = TRACK_UTF16, typename = std::enable_if_t<Enabled>>
+    size_t getUtf16Length() const;
+
+    // only available when the traits enable TRACK_HASH.
+    // equal texts always have equal hashes, different texts collide with a probability of about length / 2^61
+    template <bool Enabled = TRACK_HASH, typename = std::enable_if_t<Enabled>>
+    uint64_t getHash() const;
+    template <bool Enabled = TRACK_HASH, typename = std::enable_if_t<Enabled>>
+    uint64_t getHash(size_t index, size_t length) const;
+    template <bool Enabled = TRACK_HASH, typename = std::enable_if_t<Enabled>>
+    size_t getCommonPrefixLength(const BasicPieceTable &other) const;
+
+    // O(pieces), the snapshot holds a flat copy of the piece list
+    Snapshot takeSnapshot() const;
+    /**
+     * The changes that turn the older document into this one, ordered by offset.
+     * Only the part between the common beginning and end of both documents is diffed. With TRACK_HASH
+     * these are found by a binary search over prefix hashes in O(log^2 n), so the cost depends on the
+     * size of the change and not of the document. Without it they are found by walking the pieces from
+     * both ends, which is O(pieces) but reads no text where the documents share buffer ranges.
+     */
+    DiffList diff(const Snapshot &older) const;
+    DiffList diff(const BasicPieceTable &older) const;
+
+    /**
+     * Writes every following edit to an append-only journal at path, an existing file is replaced.
+     * The text of an insert is written once, the edits and checkpoints only refer to it. A recovery
+     * replays the edits after the last checkpoint, so checkpointJournal should be called from time to time.
+     */
+    bool startJournal(const std::string &path);
+    // rebuilds this (empty, not journaling) table from the journal at path and keeps journaling to it
+    bool recoverJournal(const std::string &path);
+    /**
+     * Writes the piece list as the new starting point of a recovery, in O(pieces) and without any text.
+     * Meant to be called when the user pauses (where an editor would autosave), it does nothing if there
+     * was no edit since the last checkpoint. The file is compacted by the writer thread when needed.
+     */
+    bool checkpointJournal();
+    // waits until every edit is on disk, false if the journal could not be written (journaling stops then)
+    bool syncJournal();
+    void stopJournal();
+    // false after stopJournal and after an error writing the journal
+    bool isJournaling() const;
+};
+
+using PieceTable = BasicPieceTable<PieceTableTraits<char>>;
+
+#include "piece_table.tpp"
+
+extern template class BasicPieceTable<PieceTableTraits<char>>;
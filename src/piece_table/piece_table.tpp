@@ -0,0 +1,1961 @@
+// implementation of BasicPieceTable, included from piece_table.hpp
+
+template <typename Traits>
+BasicPieceTable<Traits>::EditNode::EditNode(const EditPiece &data) : data(data), color(RED), parent(nullptr), left(nullptr), right(nullptr) {}
+
+template <typename Traits>
+BasicPieceTable<Traits>::EditPiece::EditPiece(const size_t bufferInfex, const BufferPosition &start, const BufferPosition &end) : bufferInfex(bufferInfex), start(start), end(end), leftSubTreeLength(0) {}
+
+template <typename Traits>
+BasicPieceTable<Traits>::Buffer::Buffer(const CharType *data, size_t length, const Allocator &allocator)
+    : piece_table_detail::BufferLineStarts<TRACK_LINES, Rebind<size_t>>(Rebind<size_t>(allocator)),
+      piece_table_detail::BufferCompression<COMPRESS_BUFFERS, Rebind<char>>(length, Rebind<char>(allocator)),
+      str(data, length, allocator)
+{
+    if constexpr (TRACK_LINES)
+    {
+        this->lineStarts.push_back(0);
+        for (size_t i = 0; i < length; i++)
+        {
+            if (data[i] == CharType('\n'))
+            {
+                this->lineStarts.push_back(i + 1);
+            }
+        }
+        this->lineStarts.shrink_to_fit();
+    }
+}
+
+template <typename Traits>
+BasicPieceTable<Traits>::NodePosition::NodePosition(size_t nodeStartOffset, EditNode *node) : nodeStartOffset(nodeStartOffset), node(node) {}
+
+template <typename Traits>
+BasicPieceTable<Traits>::BasicPieceTable(const Allocator &allocator) : nodeAllocator(allocator), editTreeRoot(nullptr), buffers(Rebind<Buffer>(allocator)), changeStreams(nullptr) {}
+
+template <typename Traits>
+BasicPieceTable<Traits>::~BasicPieceTable()
+{
+    for (ChangeStream *stream = changeStreams; stream != nullptr; stream = stream->next)
+    {
+        stream->table = nullptr;
+    }
+    destroyTree(editTreeRoot);
+}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::insert(const size_t index, const String &data) -> BasicPieceTable &
+{
+    change(index, 0, data);
+    return *this;
+}
+
+template <typename Traits>
+void BasicPieceTable<Traits>::insertPieces(const size_t index, const PieceList &x)
+{
+    if (x.empty())
+    {
+        return;
+    }
+
+    if (editTreeRoot == nullptr)
+    {
+        // tree is empty
+        EditNode *node = insertRight(nullptr, x[0]);
+        for (size_t i = 1; i < x.size(); i++)
+        {
+            node = insertRight(node, x[i]);
+        }
+        return;
+    }
+    else
+    {
+        // tree is not empty
+        NodePosition nodePosition = nodeAt(index);
+
+        if (nodePosition.nodeStartOffset == index)
+        {
+            // we are inserting into the beginning of a node.
+            // we insert one node to left and then all the rest of the nodes in sequanse to the right
+            EditNode *node = insertLeft(nodePosition.node, x[0]);
+            for (size_t i = 1; i < x.size(); i++)
+            {
+                node = insertRight(node, x[i]);
+            }
+        }
+        else if (nodePosition.nodeStartOffset + getEditPieceLength(nodePosition.node->data) > index)
+        {
+            // we are inserting into the middle of a node.
+            size_t offsetInNode = index - nodePosition.nodeStartOffset;
+            splitNode(nodePosition.node, offsetInNode);
+
+            EditNode *node = insertRight(nodePosition.node, x[0]);
+            for (size_t i = 1; i < x.size(); i++)
+            {
+                node = insertRight(node, x[i]);
+            }
+        }
+        else
+        {
+            // we are inserting into the end of a node.
+            // we insert all nodes in sequanse to the right
+            EditNode *node = insertRight(nodePosition.node, x[0]);
+            for (size_t i = 1; i < x.size(); i++)
+            {
+                node = insertRight(node, x[i]);
+            }
+        }
+    }
+}
+
+template <typename Traits>
+void BasicPieceTable<Traits>::splitNode(EditNode *const node, size_t offset)
+{
+    EditPiece &piece = node->data;
+    const Buffer &buffer = this->buffers[piece.bufferInfex];
+
+    BufferPosition splitPoint = toBufferPosition(buffer, toBufferOffset(buffer, piece.start) + offset);
+    EditPiece newPiece = EditPiece(piece.bufferInfex, splitPoint, piece.end);
+
+    // shrink the node first so its ancestors see the removed tail, then add it back as a new node
+    updateMetadata(node, piece, true);
+    piece.end = splitPoint;
+    if constexpr (TRACK_UTF16)
+    {
+        piece.utf16Length = getEditPieceUtf16Length(piece);
+        newPiece.utf16Length = getEditPieceUtf16Length(newPiece);
+    }
+    if constexpr (TRACK_HASH)
+    {
+        piece.hash = getEditPieceHash(piece, 0, offset);
+        newPiece.hash = getEditPieceHash(newPiece, 0, getEditPieceLength(newPiece));
+    }
+    updateMetadata(node, piece, false);
+    updateHash(node);
+
+    insertRight(node, newPiece);
+}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::createPieces(const String &data) -> PieceList
+{
+    size_t data_length = data.size();
+    // padding the int so the integer devision will be roung up
+    size_t arr_len = (data_length + MAX_CHAR_PER_NODE - 1) / MAX_CHAR_PER_NODE;
+
+    PieceList retData(buffers.get_allocator());
+    retData.reserve(arr_len);
+
+    size_t lengthUsed = 0;
+    size_t charsToUse, bufferIndex;
+    while (lengthUsed != data_length)
+    {
+        if (lengthUsed + MAX_CHAR_PER_NODE < data_length)
+        {
+            charsToUse = MAX_CHAR_PER_NODE;
+        }
+        else
+        {
+            charsToUse = data_length - lengthUsed;
+        }
+
+        bufferIndex = insertBuffer(data.data() + lengthUsed, charsToUse);
+        retData.push_back(createPiece(bufferIndex, 0, charsToUse));
+
+        lengthUsed += charsToUse;
+    }
+
+    return retData;
+}
+
+// a piece of the characters [start, end) of a buffer
+template <typename Traits>
+auto BasicPieceTable<Traits>::createPiece(size_t bufferIndex, size_t start, size_t end) const -> EditPiece
+{
+    const Buffer &buffer = buffers[bufferIndex];
+    EditPiece piece(bufferIndex, toBufferPosition(buffer, start), toBufferPosition(buffer, end));
+    if constexpr (TRACK_UTF16)
+    {
+        piece.utf16Length = getEditPieceUtf16Length(piece);
+    }
+    if constexpr (TRACK_HASH)
+    {
+        piece.hash = getEditPieceHash(piece, 0, end - start);
+    }
+    return piece;
+}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::remove(const size_t index, const size_t &length) -> BasicPieceTable &
+{
+    change(index, length, String(buffers.get_allocator()));
+    return *this;
+}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::replace(const size_t index, const size_t &length, const String &data) -> BasicPieceTable &
+{
+    change(index, length, data);
+    return *this;
+}
+
+template <typename Traits>
+void BasicPieceTable<Traits>::change(size_t index, size_t length, const String &data)
+{
+    size_t documentLength = getLength();
+    index = std::min(index, documentLength);
+    length = std::min(length, documentLength - index);
+    if (length == 0 && data.empty())
+    {
+        return;
+    }
+
+    // the line numbers are only looked up if somebody listens
+    ChangeEvent event{index, length, data.size(), 0, 0, 0};
+    if constexpr (TRACK_LINES)
+    {
+        if (changeStreams != nullptr)
+        {
+            event.startLine = getLineAt(index);
+            event.oldEndLine = getLineAt(index + length);
+        }
+    }
+
+    size_t firstBuffer = buffers.size();
+    removePieces(index, length);
+    insertPieces(index, createPieces(data));
+
+    if (journal.isOpen())
+    {
+        // one record per edit, so recovery replays a replace completely or not at all
+        journal.writeEdit(index, length, firstBuffer, buffers.size() - firstBuffer);
+    }
+
+    if (changeStreams != nullptr)
+    {
+        if constexpr (TRACK_LINES)
+        {
+            event.newEndLine = getLineAt(index + data.size());
+        }
+        for (ChangeStream *stream = changeStreams; stream != nullptr; stream = stream->next)
+        {
+            stream->push(event);
+        }
+    }
+}
+
+template <typename Traits>
+void BasicPieceTable<Traits>::removePieces(const size_t index, const size_t length)
+{
+    if (length == 0)
+    {
+        return;
+    }
+
+    // after the splits the range is made of whole nodes
+    splitAt(index + length);
+    splitAt(index);
+
+    size_t removedLength = 0;
+    while (removedLength < length)
+    {
+        NodePosition nodePosition = nodeAt(index);
+        EditNode *node = nodePosition.node;
+        if (nodePosition.nodeStartOffset != index)
+        {
+            // nodeAt returns the node that ends at index
+            node = getNextNode(node);
+        }
+
+        removedLength += getEditPieceLength(node->data);
+        removeNode(node);
+    }
+}
+
+// makes sure a node starts at index
+template <typename Traits>
+void BasicPieceTable<Traits>::splitAt(size_t index)
+{
+    NodePosition nodePosition = nodeAt(index);
+    if (nodePosition.node != nullptr && nodePosition.nodeStartOffset < index && index < nodePosition.nodeStartOffset + getEditPieceLength(nodePosition.node->data))
+    {
+        splitNode(nodePosition.node, index - nodePosition.nodeStartOffset);
+    }
+}
+
+template <typename Traits>
+size_t BasicPieceTable<Traits>::insertBuffer(const CharType *data, size_t length)
+{
+    this->buffers.emplace_back(data, length, this->buffers.get_allocator());
+    size_t bufferIndex = this->buffers.size() - 1;
+    if (journal.isOpen())
+    {
+        journal.writeBuffer(bufferIndex, data, length);
+    }
+    if constexpr (COMPRESS_BUFFERS)
+    {
+        if (length >= MIN_COMPRESSED_BUFFER_SIZE)
+        {
+            addHotBuffer(bufferIndex);
+        }
+    }
+    return bufferIndex;
+}
+
+// the text of a buffer, decompressed on demand. The reference stays valid until the text of two other buffers is requested
+template <typename Traits>
+auto BasicPieceTable<Traits>::getBufferText(size_t bufferIndex) const -> const String &
+{
+    const Buffer &buffer = this->buffers[bufferIndex];
+    if constexpr (COMPRESS_BUFFERS)
+    {
+        if (buffer.str.empty() && buffer.length != 0)
+        {
+            buffer.str.resize(buffer.length);
+            if (!piece_table_detail::lz4Decompress(reinterpret_cast<const unsigned char *>(buffer.compressed.data()), buffer.compressed.size(),
+                                                   reinterpret_cast<unsigned char *>(&buffer.str[0]), buffer.length * sizeof(CharType)))
+            {
+                // the block was compressed by this table and is never changed, so memory got corrupted
+                std::abort();
+            }
+            addHotBuffer(bufferIndex);
+        }
+        buffer.lastUse = ++this->bufferClock;
+    }
+    return buffer.str;
+}
+
+// makes the buffer the most recently used one, the least recently used buffer gets cold if there are too many
+template <typename Traits>
+void BasicPieceTable<Traits>::addHotBuffer(size_t bufferIndex) const
+{
+    if constexpr (COMPRESS_BUFFERS)
+    {
+        this->hotBuffers.push_back(bufferIndex);
+        this->buffers[bufferIndex].lastUse = ++this->bufferClock;
+
+        if (this->hotBuffers.size() > HOT_BUFFER_COUNT)
+        {
+            size_t leastRecent = 0;
+            for (size_t i = 1; i < this->hotBuffers.size(); i++)
+            {
+                if (this->buffers[this->hotBuffers[i]].lastUse < this->buffers[this->hotBuffers[leastRecent]].lastUse)
+                    leastRecent = i;
+            }
+            evictHotBuffer(leastRecent);
+        }
+    }
+}
+
+template <typename Traits>
+void BasicPieceTable<Traits>::evictHotBuffer(size_t position) const
+{
+    if constexpr (COMPRESS_BUFFERS)
+    {
+        const Buffer &buffer = this->buffers[this->hotBuffers[position]];
+        this->hotBuffers[position] = this->hotBuffers.back();
+        this->hotBuffers.pop_back();
+
+        if (buffer.compressed.empty())
+        {
+            // the first time the buffer gets cold, buffers are never changed so this is the only compression
+            size_t byteLength = buffer.length * sizeof(CharType);
+            piece_table_detail::lz4Compress(reinterpret_cast<const unsigned char *>(buffer.str.data()), byteLength, buffer.compressed);
+            if (buffer.compressed.size() >= byteLength)
+            {
+                // incompressible, it stays decompressed and is never tried again
+                std::vector<char, Rebind<char>>(buffer.compressed.get_allocator()).swap(buffer.compressed);
+                return;
+            }
+            buffer.compressed.shrink_to_fit();
+        }
+
+        String(buffer.str.get_allocator()).swap(buffer.str);
+    }
+}
+
+template <typename Traits>
+void BasicPieceTable<Traits>::compressBuffers()
+{
+    if constexpr (COMPRESS_BUFFERS)
+    {
+        while (!this->hotBuffers.empty())
+        {
+            evictHotBuffer(this->hotBuffers.size() - 1);
+        }
+    }
+}
+
+template <typename Traits>
+template <bool Enabled, typename>
+auto BasicPieceTable<Traits>::getBufferStatistics() const -> BufferStatistics
+{
+    BufferStatistics statistics{0, 0, 0};
+    for (const Buffer &buffer : buffers)
+    {
+        statistics.textBytes += buffer.str.size() * sizeof(CharType);
+        statistics.compressedBytes += buffer.compressed.size();
+        statistics.compressedBuffers += buffer.compressed.empty() ? 0 : 1;
+    }
+    return statistics;
+}
+
+template <typename Traits>
+size_t BasicPieceTable<Traits>::toBufferOffset(const Buffer &buffer, const BufferPosition &position) const
+{
+    if constexpr (TRACK_LINES)
+    {
+        return buffer.lineStarts[position.index] + position.offset;
+    }
+    else
+    {
+        return position.offset;
+    }
+}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::toBufferPosition(const Buffer &buffer, size_t offset) const -> BufferPosition
+{
+    if constexpr (TRACK_LINES)
+    {
+        // the last line that starts at or before the offset
+        size_t line = std::upper_bound(buffer.lineStarts.begin(), buffer.lineStarts.end(), offset) - buffer.lineStarts.begin() - 1;
+        return BufferPosition(line, offset - buffer.lineStarts[line]);
+    }
+    else
+    {
+        return BufferPosition(offset);
+    }
+}
+
+template <typename Traits>
+size_t BasicPieceTable<Traits>::getEditPieceLength(const EditPiece &piece) const
+{
+    const Buffer &buffer = this->buffers[piece.bufferInfex];
+    return toBufferOffset(buffer, piece.end) - toBufferOffset(buffer, piece.start);
+}
+
+template <typename Traits>
+size_t BasicPieceTable<Traits>::getEditPieceLineCount(const EditPiece &piece) const
+{
+    if constexpr (TRACK_LINES)
+    {
+        return piece.end.index - piece.start.index;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+template <typename Traits>
+size_t BasicPieceTable<Traits>::getEditPieceUtf16Length(const EditPiece &piece) const
+{
+    const Buffer &buffer = this->buffers[piece.bufferInfex];
+    const CharType *data = getBufferText(piece.bufferInfex).data();
+    return piece_table_detail::countUtf16Units(data + toBufferOffset(buffer, piece.start), data + toBufferOffset(buffer, piece.end));
+}
+
+// hash of the characters [from, to) of the piece
+template <typename Traits>
+uint64_t BasicPieceTable<Traits>::getEditPieceHash(const EditPiece &piece, size_t from, size_t to) const
+{
+    const Buffer &buffer = this->buffers[piece.bufferInfex];
+    const CharType *data = getBufferText(piece.bufferInfex).data() + toBufferOffset(buffer, piece.start);
+    return piece_table_detail::hashText(data + from, data + to);
+}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::nodeAt(size_t index) const -> NodePosition
+{
+    EditNode *currentNode = editTreeRoot;
+    size_t currentOffset = 0;
+    while (currentNode != nullptr)
+    {
+        if (currentNode->data.leftSubTreeLength > index)
+        {
+            currentNode = currentNode->left;
+        }
+        else if (currentNode->data.leftSubTreeLength + getEditPieceLength(currentNode->data) >= index)
+        {
+            return NodePosition(currentOffset + currentNode->data.leftSubTreeLength, currentNode);
+        }
+        else
+        {
+            index -= currentNode->data.leftSubTreeLength + getEditPieceLength(currentNode->data);
+            currentOffset += currentNode->data.leftSubTreeLength + getEditPieceLength(currentNode->data);
+            currentNode = currentNode->right;
+        }
+    }
+
+    return NodePosition(0, nullptr);
+}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::createNode(const EditPiece &piece) -> EditNode *
+{
+    EditNode *node = std::allocator_traits<NodeAllocator>::allocate(nodeAllocator, 1);
+    std::allocator_traits<NodeAllocator>::construct(nodeAllocator, node, piece);
+    return node;
+}
+
+template <typename Traits>
+void BasicPieceTable<Traits>::destroyNode(EditNode *node)
+{
+    std::allocator_traits<NodeAllocator>::destroy(nodeAllocator, node);
+    std::allocator_traits<NodeAllocator>::deallocate(nodeAllocator, node, 1);
+}
+
+template <typename Traits>
+void BasicPieceTable<Traits>::destroyTree(EditNode *node)
+{
+    if (node == nullptr)
+        return;
+
+    destroyTree(node->left);
+    destroyTree(node->right);
+    destroyNode(node);
+}
+
+template <typename Traits>
+void BasicPieceTable<Traits>::removeNode(EditNode *node)
+{
+    if (node->left != nullptr && node->right != nullptr)
+    {
+        // move the piece of the successor into node and unlink the successor instead
+        EditNode *successor = findSmallest(node->right);
+        updateMetadata(successor, successor->data, true);
+        updateMetadata(node, node->data, true);
+
+        EditPiece piece = successor->data;
+        piece.leftSubTreeLength = node->data.leftSubTreeLength;
+        if constexpr (TRACK_LINES)
+            piece.leftSubTreeLineCount = node->data.leftSubTreeLineCount;
+        if constexpr (TRACK_UTF16)
+            piece.leftSubTreeUtf16Length = node->data.leftSubTreeUtf16Length;
+        node->data = piece;
+
+        updateMetadata(node, node->data, false);
+        node = successor;
+    }
+    else
+    {
+        updateMetadata(node, node->data, true);
+    }
+
+    // node has at most one child now, which takes its place
+    EditNode *child = node->left != nullptr ? node->left : node->right;
+    EditNode *parent = node->parent;
+    if (child != nullptr)
+        child->parent = parent;
+    if (parent == nullptr)
+        editTreeRoot = child;
+    else if (node == parent->left)
+        parent->left = child;
+    else
+        parent->right = child;
+
+    updateHash(parent);
+    if (node->color == BLACK)
+        fixRemove(child, parent);
+
+    destroyNode(node);
+}
+
+// node took the place of a removed black node and may be nullptr, so its parent is passed as well
+template <typename Traits>
+void BasicPieceTable<Traits>::fixRemove(EditNode *node, EditNode *parent)
+{
+    while (node != editTreeRoot && (node == nullptr || node->color == BLACK))
+    {
+        if (node == parent->left)
+        {
+            EditNode *sibling = parent->right;
+            if (sibling->color == RED)
+            {
+                sibling->color = BLACK;
+                parent->color = RED;
+                rotateLeft(parent);
+                sibling = parent->right;
+            }
+            if ((sibling->left == nullptr || sibling->left->color == BLACK) && (sibling->right == nullptr || sibling->right->color == BLACK))
+            {
+                sibling->color = RED;
+                node = parent;
+                parent = node->parent;
+            }
+            else
+            {
+                if (sibling->right == nullptr || sibling->right->color == BLACK)
+                {
+                    sibling->left->color = BLACK;
+                    sibling->color = RED;
+                    rotateRight(sibling);
+                    sibling = parent->right;
+                }
+                sibling->color = parent->color;
+                parent->color = BLACK;
+                sibling->right->color = BLACK;
+                rotateLeft(parent);
+                node = editTreeRoot;
+            }
+        }
+        else
+        {
+            EditNode *sibling = parent->left;
+            if (sibling->color == RED)
+            {
+                sibling->color = BLACK;
+                parent->color = RED;
+                rotateRight(parent);
+                sibling = parent->left;
+            }
+            if ((sibling->left == nullptr || sibling->left->color == BLACK) && (sibling->right == nullptr || sibling->right->color == BLACK))
+            {
+                sibling->color = RED;
+                node = parent;
+                parent = node->parent;
+            }
+            else
+            {
+                if (sibling->left == nullptr || sibling->left->color == BLACK)
+                {
+                    sibling->right->color = BLACK;
+                    sibling->color = RED;
+                    rotateLeft(sibling);
+                    sibling = parent->left;
+                }
+                sibling->color = parent->color;
+                parent->color = BLACK;
+                sibling->left->color = BLACK;
+                rotateRight(parent);
+                node = editTreeRoot;
+            }
+        }
+    }
+    if (node != nullptr)
+        node->color = BLACK;
+}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::findSmallest(EditNode *node) const -> EditNode *
+{
+    if (node == nullptr)
+        return nullptr;
+    while (node->left != nullptr)
+    {
+        node = node->left;
+    }
+    return node;
+}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::findBiggest(EditNode *node) const -> EditNode *
+{
+    if (node == nullptr)
+        return nullptr;
+    while (node->right != nullptr)
+    {
+        node = node->right;
+    }
+    return node;
+}
+
+/**
+ *      node              node
+ *     /  \              /  \
+ *    a   b    ---->   a    b
+ *                         /
+ *                        z
+ */
+template <typename Traits>
+auto BasicPieceTable<Traits>::insertRight(EditNode *const node, const EditPiece &piece) -> EditNode *
+{
+    EditNode *newNode = createNode(piece);
+    newNode->data.leftSubTreeLength = 0;
+    if constexpr (TRACK_LINES)
+        newNode->data.leftSubTreeLineCount = 0;
+    if constexpr (TRACK_UTF16)
+        newNode->data.leftSubTreeUtf16Length = 0;
+
+    if (editTreeRoot == nullptr)
+    {
+        editTreeRoot = newNode;
+        editTreeRoot->color = BLACK;
+    }
+    else if (node->right == nullptr)
+    {
+        node->right = newNode;
+        newNode->parent = node;
+    }
+    else
+    {
+        EditNode *nextNode = findSmallest(node->right);
+        nextNode->left = newNode;
+        newNode->parent = nextNode;
+    }
+
+    fixInsert(newNode);
+
+    return newNode;
+}
+
+/**
+ *      node              node
+ *     /  \              /  \
+ *    a   b     ---->   a    b
+ *                       \
+ *                        z
+ */
+template <typename Traits>
+auto BasicPieceTable<Traits>::insertLeft(EditNode *const node, const EditPiece &piece) -> EditNode *
+{
+    EditNode *newNode = createNode(piece);
+    newNode->data.leftSubTreeLength = 0;
+    if constexpr (TRACK_LINES)
+        newNode->data.leftSubTreeLineCount = 0;
+    if constexpr (TRACK_UTF16)
+        newNode->data.leftSubTreeUtf16Length = 0;
+
+    if (editTreeRoot == nullptr)
+    {
+        editTreeRoot = newNode;
+        editTreeRoot->color = BLACK;
+    }
+    else if (node->left == nullptr)
+    {
+        node->left = newNode;
+        newNode->parent = node;
+    }
+    else
+    {
+        EditNode *nextNode = findBiggest(node->left);
+        nextNode->right = newNode;
+        newNode->parent = nextNode;
+    }
+
+    fixInsert(newNode);
+
+    return newNode;
+}
+
+template <typename Traits>
+void BasicPieceTable<Traits>::rotateRight(EditNode *node)
+{
+    EditNode *child = node->left;
+
+    // fix size of parent
+    node->data.leftSubTreeLength -= (child->data.leftSubTreeLength + getEditPieceLength(child->data));
+    if constexpr (TRACK_LINES)
+        node->data.leftSubTreeLineCount -= (child->data.leftSubTreeLineCount + getEditPieceLineCount(child->data));
+    if constexpr (TRACK_UTF16)
+        node->data.leftSubTreeUtf16Length -= (child->data.leftSubTreeUtf16Length + child->data.utf16Length);
+
+    node->left = child->right;
+    if (node->left != nullptr)
+        node->left->parent = node;
+    child->parent = node->parent;
+    if (node->parent == nullptr)
+        editTreeRoot = child;
+    else if (node == node->parent->left)
+        node->parent->left = child;
+    else
+        node->parent->right = child;
+    child->right = node;
+    node->parent = child;
+
+    // node is now below child, so it has to be recomputed first
+    if constexpr (TRACK_HASH)
+    {
+        updateSubTreeHash(node);
+        updateSubTreeHash(child);
+    }
+}
+
+template <typename Traits>
+void BasicPieceTable<Traits>::rotateLeft(EditNode *node)
+{
+    EditNode *child = node->right;
+
+    // fix size of child
+    child->data.leftSubTreeLength += node->data.leftSubTreeLength + getEditPieceLength(node->data);
+    if constexpr (TRACK_LINES)
+        child->data.leftSubTreeLineCount += node->data.leftSubTreeLineCount + getEditPieceLineCount(node->data);
+    if constexpr (TRACK_UTF16)
+        child->data.leftSubTreeUtf16Length += node->data.leftSubTreeUtf16Length + node->data.utf16Length;
+
+    node->right = child->left;
+    if (node->right != nullptr)
+        node->right->parent = node;
+    child->parent = node->parent;
+    if (node->parent == nullptr)
+        editTreeRoot = child;
+    else if (node == node->parent->left)
+        node->parent->left = child;
+    else
+        node->parent->right = child;
+    child->left = node;
+    node->parent = child;
+
+    // node is now below child, so it has to be recomputed first
+    if constexpr (TRACK_HASH)
+    {
+        updateSubTreeHash(node);
+        updateSubTreeHash(child);
+    }
+}
+
+template <typename Traits>
+void BasicPieceTable<Traits>::fixInsert(EditNode *node)
+{
+    updateMetadata(node, node->data, false);
+    updateHash(node);
+
+    EditNode *parent = nullptr;
+    EditNode *grandparent = nullptr;
+    while (node != editTreeRoot && node->color == RED && node->parent->color == RED)
+    {
+        parent = node->parent;
+        grandparent = parent->parent;
+        if (parent == grandparent->left)
+        {
+            EditNode *uncle = grandparent->right;
+            if (uncle != nullptr && uncle->color == RED)
+            {
+                grandparent->color = RED;
+                parent->color = BLACK;
+                uncle->color = BLACK;
+                node = grandparent;
+            }
+            else
+            {
+                if (node == parent->right)
+                {
+                    rotateLeft(parent);
+                    node = parent;
+                    parent = node->parent;
+                }
+                rotateRight(grandparent);
+                std::swap(parent->color, grandparent->color);
+                node = parent;
+            }
+        }
+        else
+        {
+            EditNode *uncle = grandparent->left;
+            if (uncle != nullptr && uncle->color == RED)
+            {
+                grandparent->color = RED;
+                parent->color = BLACK;
+                uncle->color = BLACK;
+                node = grandparent;
+            }
+            else
+            {
+                if (node == parent->left)
+                {
+                    rotateRight(parent);
+                    node = parent;
+                    parent = node->parent;
+                }
+                rotateLeft(grandparent);
+                std::swap(parent->color, grandparent->color);
+                node = parent;
+            }
+        }
+    }
+    editTreeRoot->color = BLACK;
+}
+
+// adds (or subtracts when removed is set) the size of piece to every ancestor that has node in its left subtree
+template <typename Traits>
+void BasicPieceTable<Traits>::updateMetadata(EditNode *node, const EditPiece &piece, bool removed)
+{
+    size_t lengthDelta = getEditPieceLength(piece);
+    size_t lineCountDelta = getEditPieceLineCount(piece);
+    size_t utf16Delta = 0;
+    if constexpr (TRACK_UTF16)
+        utf16Delta = piece.utf16Length;
+
+    if (removed)
+    {
+        // unsigned wrap around turns the additions below into subtractions
+        lengthDelta = size_t(0) - lengthDelta;
+        lineCountDelta = size_t(0) - lineCountDelta;
+        utf16Delta = size_t(0) - utf16Delta;
+    }
+
+    while (node != editTreeRoot)
+    {
+        if (node->parent->left == node)
+        {
+            node->parent->data.leftSubTreeLength += lengthDelta;
+            if constexpr (TRACK_LINES)
+                node->parent->data.leftSubTreeLineCount += lineCountDelta;
+            if constexpr (TRACK_UTF16)
+                node->parent->data.leftSubTreeUtf16Length += utf16Delta;
+        }
+        node = node->parent;
+    }
+}
+
+// recomputes the subtree hashes of node and all of its ancestors
+template <typename Traits>
+void BasicPieceTable<Traits>::updateHash(EditNode *node)
+{
+    if constexpr (TRACK_HASH)
+    {
+        for (; node != nullptr; node = node->parent)
+        {
+            updateSubTreeHash(node);
+        }
+    }
+}
+
+// recomputes the subtree hash of node from its children, which must be up to date
+template <typename Traits>
+void BasicPieceTable<Traits>::updateSubTreeHash(EditNode *node)
+{
+    if constexpr (TRACK_HASH)
+    {
+        EditPiece &piece = node->data;
+        uint64_t pieceHash = piece.hash, piecePower = piece_table_detail::hashPower(getEditPieceLength(piece));
+        if (node->left != nullptr)
+        {
+            pieceHash = piece_table_detail::hashConcat(node->left->data.subTreeHash, pieceHash, piecePower);
+            piecePower = piece_table_detail::hashMultiply(node->left->data.subTreePower, piecePower);
+        }
+        if (node->right != nullptr)
+        {
+            pieceHash = piece_table_detail::hashConcat(pieceHash, node->right->data.subTreeHash, node->right->data.subTreePower);
+            piecePower = piece_table_detail::hashMultiply(piecePower, node->right->data.subTreePower);
+        }
+        piece.subTreeHash = pieceHash;
+        piece.subTreePower = piecePower;
+    }
+}
+
+template <typename Traits>
+size_t BasicPieceTable<Traits>::calculateLength(EditNode *node) const
+{
+    if (node == nullptr)
+    {
+        return 0;
+    }
+
+    return node->data.leftSubTreeLength + getEditPieceLength(node->data) + calculateLength(node->right);
+}
+
+template <typename Traits>
+size_t BasicPieceTable<Traits>::calculateLineCount(EditNode *node) const
+{
+    if constexpr (TRACK_LINES)
+    {
+        if (node == nullptr)
+        {
+            return 0;
+        }
+
+        return node->data.leftSubTreeLineCount + getEditPieceLineCount(node->data) + calculateLineCount(node->right);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+template <typename Traits>
+size_t BasicPieceTable<Traits>::calculateUtf16Length(EditNode *node) const
+{
+    if constexpr (TRACK_UTF16)
+    {
+        if (node == nullptr)
+        {
+            return 0;
+        }
+
+        return node->data.leftSubTreeUtf16Length + node->data.utf16Length + calculateUtf16Length(node->right);
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+template <typename Traits>
+size_t BasicPieceTable<Traits>::getLength() const
+{
+    return calculateLength(editTreeRoot);
+}
+
+template <typename Traits>
+template <bool Enabled, typename>
+size_t BasicPieceTable<Traits>::getLineCount() const
+{
+    return calculateLineCount(editTreeRoot) + 1;
+}
+
+template <typename Traits>
+template <bool Enabled, typename>
+size_t BasicPieceTable<Traits>::getUtf16Length() const
+{
+    return calculateUtf16Length(editTreeRoot);
+}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::getText() const -> String
+{
+    return getText(0, getLength());
+}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::getText(size_t index, size_t length) const -> String
+{
+    String retString(buffers.get_allocator());
+    if (length == 0)
+    {
+        return retString;
+    }
+
+    NodePosition nodePosition = nodeAt(index);
+    EditNode *currentNode = nodePosition.node;
+    size_t from = index - nodePosition.nodeStartOffset;
+    while (currentNode != nullptr && retString.size() < length)
+    {
+        size_t pieceLength = getEditPieceLength(currentNode->data);
+        size_t to = std::min(pieceLength, from + length - retString.size());
+        appendEditPieceText(retString, currentNode->data, from, to);
+
+        from = 0;
+        currentNode = getNextNode(currentNode);
+    }
+
+    return retString;
+}
+
+// hash of the first length characters of the document
+template <typename Traits>
+template <bool Enabled, typename>
+uint64_t BasicPieceTable<Traits>::calculatePrefixHash(size_t length) const
+{
+    EditNode *currentNode = editTreeRoot;
+    uint64_t hash = 0;
+    while (currentNode != nullptr && length != 0)
+    {
+        const EditPiece &piece = currentNode->data;
+        if (piece.leftSubTreeLength >= length)
+        {
+            currentNode = currentNode->left;
+            continue;
+        }
+
+        if (currentNode->left != nullptr)
+        {
+            hash = piece_table_detail::hashConcat(hash, currentNode->left->data.subTreeHash, currentNode->left->data.subTreePower);
+            length -= piece.leftSubTreeLength;
+        }
+
+        size_t pieceLength = getEditPieceLength(piece);
+        if (pieceLength >= length)
+        {
+            // only a part of this piece is needed, it is at most MAX_CHAR_PER_NODE long
+            uint64_t pieceHash = pieceLength == length ? piece.hash : getEditPieceHash(piece, 0, length);
+            return piece_table_detail::hashConcat(hash, pieceHash, piece_table_detail::hashPower(length));
+        }
+
+        hash = piece_table_detail::hashConcat(hash, piece.hash, piece_table_detail::hashPower(pieceLength));
+        length -= pieceLength;
+        currentNode = currentNode->right;
+    }
+
+    return hash;
+}
+
+template <typename Traits>
+template <bool Enabled, typename>
+uint64_t BasicPieceTable<Traits>::getHash() const
+{
+    return editTreeRoot == nullptr ? 0 : editTreeRoot->data.subTreeHash;
+}
+
+template <typename Traits>
+template <bool Enabled, typename>
+uint64_t BasicPieceTable<Traits>::getHash(size_t index, size_t length) const
+{
+    // hash(prefix + range) = hash(prefix) * B^length + hash(range)
+    uint64_t prefixHash = piece_table_detail::hashMultiply(calculatePrefixHash(index), piece_table_detail::hashPower(length));
+    return piece_table_detail::hashReduce(calculatePrefixHash(index + length) + piece_table_detail::HASH_MOD - prefixHash);
+}
+
+// length of the longest common prefix of both documents, found by a binary search over prefix hashes
+template <typename Traits>
+template <bool Enabled, typename>
+size_t BasicPieceTable<Traits>::getCommonPrefixLength(const BasicPieceTable &other) const
+{
+    return searchCommonLength(std::min(getLength(), other.getLength()), [&](size_t length)
+                              { return calculatePrefixHash(length) == other.calculatePrefixHash(length); });
+}
+
+// the line the character at index is in
+template <typename Traits>
+template <bool Enabled, typename>
+size_t BasicPieceTable<Traits>::getLineAt(size_t index) const
+{
+    EditNode *currentNode = editTreeRoot;
+    size_t line = 0;
+    while (currentNode != nullptr)
+    {
+        const EditPiece &piece = currentNode->data;
+        if (piece.leftSubTreeLength >= index)
+        {
+            currentNode = currentNode->left;
+            continue;
+        }
+
+        index -= piece.leftSubTreeLength;
+        line += piece.leftSubTreeLineCount;
+        size_t pieceLength = getEditPieceLength(piece);
+        if (pieceLength >= index)
+        {
+            const Buffer &buffer = buffers[piece.bufferInfex];
+            return line + toBufferPosition(buffer, toBufferOffset(buffer, piece.start) + index).index - piece.start.index;
+        }
+
+        index -= pieceLength;
+        line += getEditPieceLineCount(piece);
+        currentNode = currentNode->right;
+    }
+
+    return line;
+}
+
+// offset in the document of the first character of the given line
+template <typename Traits>
+template <bool Enabled, typename>
+size_t BasicPieceTable<Traits>::getLineStartOffset(size_t line) const
+{
+    if (line == 0)
+    {
+        return 0;
+    }
+
+    // the line starts right after the line-th line break
+    EditNode *currentNode = editTreeRoot;
+    size_t currentOffset = 0;
+    while (currentNode != nullptr)
+    {
+        size_t pieceLineCount = getEditPieceLineCount(currentNode->data);
+        if (currentNode->data.leftSubTreeLineCount >= line)
+        {
+            currentNode = currentNode->left;
+        }
+        else if (currentNode->data.leftSubTreeLineCount + pieceLineCount >= line)
+        {
+            line -= currentNode->data.leftSubTreeLineCount;
+            const EditPiece &piece = currentNode->data;
+            const Buffer &buffer = buffers[piece.bufferInfex];
+            return currentOffset + piece.leftSubTreeLength + buffer.lineStarts[piece.start.index + line] - toBufferOffset(buffer, piece.start);
+        }
+        else
+        {
+            line -= currentNode->data.leftSubTreeLineCount + pieceLineCount;
+            currentOffset += currentNode->data.leftSubTreeLength + getEditPieceLength(currentNode->data);
+            currentNode = currentNode->right;
+        }
+    }
+
+    return getLength();
+}
+
+template <typename Traits>
+template <bool Enabled, typename>
+auto BasicPieceTable<Traits>::getLineContent(size_t line) const -> String
+{
+    if (line >= getLineCount())
+    {
+        return String(buffers.get_allocator());
+    }
+
+    size_t startIndex = getLineStartOffset(line);
+    size_t endIndex = line + 1 < getLineCount() ? getLineStartOffset(line + 1) - 1 : getLength(); // without the line break
+
+    return getText(startIndex, endIndex - startIndex);
+}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::getNextNode(EditNode *node) const -> EditNode *
+{
+    if (node == nullptr)
+    {
+        return nullptr;
+    }
+
+    if (node->right)
+    {
+        return findSmallest(node->right);
+    }
+
+    EditNode *parent = node->parent;
+    while (parent && node == parent->right)
+    {
+        node = parent;
+        parent = parent->parent;
+    }
+
+    return node->parent;
+}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::getPreviousNode(EditNode *node) const -> EditNode *
+{
+    if (node == nullptr)
+    {
+        return nullptr;
+    }
+
+    if (node->left)
+    {
+        return findBiggest(node->left);
+    }
+
+    EditNode *parent = node->parent;
+    while (parent && node == parent->left)
+    {
+        node = parent;
+        parent = parent->parent;
+    }
+
+    return node->parent;
+}
+
+// appends the characters [from, to) of the piece
+template <typename Traits>
+void BasicPieceTable<Traits>::appendEditPieceText(String &target, const EditPiece &piece, size_t from, size_t to) const
+{
+    const Buffer &currentBuffer = buffers[piece.bufferInfex];
+    size_t startIndex = toBufferOffset(currentBuffer, piece.start);
+
+    target.append(getBufferText(piece.bufferInfex), startIndex + from, to - from);
+}
+
+template <typename Traits>
+BasicPieceTable<Traits>::Snapshot::Snapshot(const BasicPieceTable *table)
+    : piece_table_detail::SnapshotHashes<TRACK_HASH, Rebind<uint64_t>>(Rebind<uint64_t>(table->buffers.get_allocator())),
+      table(table), spans(table->buffers.get_allocator()), offsets(table->buffers.get_allocator()) {}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::takeSnapshot() const -> Snapshot
+{
+    Snapshot snapshot(this);
+    size_t offset = 0;
+    uint64_t hash = 0;
+    for (EditNode *currentNode = findSmallest(editTreeRoot); currentNode != nullptr; currentNode = getNextNode(currentNode))
+    {
+        const EditPiece &piece = currentNode->data;
+        const Buffer &buffer = buffers[piece.bufferInfex];
+        size_t start = toBufferOffset(buffer, piece.start), end = toBufferOffset(buffer, piece.end);
+        offset += end - start;
+        if constexpr (TRACK_HASH)
+        {
+            hash = piece_table_detail::hashConcat(hash, piece.hash, piece_table_detail::hashPower(end - start));
+        }
+
+        // neighbouring pieces that continue each other in the same buffer are merged
+        if (snapshot.spans.empty() || snapshot.spans.back().bufferInfex != piece.bufferInfex || snapshot.spans.back().end != start)
+        {
+            snapshot.spans.push_back(PieceSpan{piece.bufferInfex, start, end});
+            snapshot.offsets.push_back(offset);
+            if constexpr (TRACK_HASH)
+            {
+                snapshot.prefixHashes.push_back(hash);
+            }
+        }
+        else
+        {
+            snapshot.spans.back().end = end;
+            snapshot.offsets.back() = offset;
+            if constexpr (TRACK_HASH)
+            {
+                snapshot.prefixHashes.back() = hash;
+            }
+        }
+    }
+    return snapshot;
+}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::diff(const Snapshot &older) const -> DiffList
+{
+    size_t olderLength = older.offsets.empty() ? 0 : older.offsets.back();
+    size_t prefix, suffix;
+    if constexpr (TRACK_HASH)
+    {
+        findCommonEnds(olderLength, [&older](size_t length)
+                       { return older.table->calculateSnapshotPrefixHash(older, length); }, prefix, suffix);
+    }
+    else
+    {
+        findCommonEnds(SpanCursor(older.table, &older.spans, false), SpanCursor(older.table, &older.spans, true), olderLength, prefix, suffix);
+    }
+    return diffSpans(*older.table, getSnapshotSpans(older, prefix, olderLength - suffix), *this, getSpans(prefix, getLength() - suffix), prefix);
+}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::diff(const BasicPieceTable &older) const -> DiffList
+{
+    size_t olderLength = older.getLength();
+    size_t prefix, suffix;
+    if constexpr (TRACK_HASH)
+    {
+        findCommonEnds(olderLength, [&older](size_t length)
+                       { return older.calculatePrefixHash(length); }, prefix, suffix);
+    }
+    else
+    {
+        findCommonEnds(SpanCursor(&older, nullptr, false), SpanCursor(&older, nullptr, true), olderLength, prefix, suffix);
+    }
+    return diffSpans(older, older.getSpans(prefix, olderLength - suffix), *this, getSpans(prefix, getLength() - suffix), prefix);
+}
+
+// hash of the first length characters of the snapshot
+template <typename Traits>
+template <bool Enabled, typename>
+uint64_t BasicPieceTable<Traits>::calculateSnapshotPrefixHash(const Snapshot &snapshot, size_t length) const
+{
+    auto spanEnd = std::lower_bound(snapshot.offsets.begin(), snapshot.offsets.end(), length);
+    if (spanEnd == snapshot.offsets.end())
+    {
+        return snapshot.prefixHashes.empty() ? 0 : snapshot.prefixHashes.back();
+    }
+
+    size_t span = spanEnd - snapshot.offsets.begin();
+    if (*spanEnd == length)
+    {
+        return snapshot.prefixHashes[span];
+    }
+
+    // the rest is a part of one span, which is at most one buffer long
+    size_t spanStart = span == 0 ? 0 : snapshot.offsets[span - 1];
+    uint64_t hash = span == 0 ? 0 : snapshot.prefixHashes[span - 1];
+    const CharType *data = getBufferText(snapshot.spans[span].bufferInfex).data() + snapshot.spans[span].start;
+    return piece_table_detail::hashConcat(hash, piece_table_detail::hashText(data, data + length - spanStart), piece_table_detail::hashPower(length - spanStart));
+}
+
+// the biggest length <= maxLength for which equalPrefix(length) holds, equalPrefix has to be monotonic
+template <typename Traits>
+template <typename Equal>
+size_t BasicPieceTable<Traits>::searchCommonLength(size_t maxLength, Equal equalPrefix)
+{
+    size_t low = 0, high = maxLength;
+    if (equalPrefix(high))
+    {
+        return high;
+    }
+
+    // invariant: equalPrefix(low) holds, equalPrefix(high) does not
+    while (high - low > 1)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (equalPrefix(middle))
+            low = middle;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+// the lengths of the common beginning and end of the older document and this one, found by comparing hashes
+template <typename Traits>
+template <typename OlderPrefixHash>
+void BasicPieceTable<Traits>::findCommonEnds(size_t olderLength, OlderPrefixHash olderPrefixHash, size_t &prefix, size_t &suffix) const
+{
+    size_t newerLength = getLength();
+    size_t maxLength = std::min(olderLength, newerLength);
+    prefix = searchCommonLength(maxLength, [&](size_t length)
+                                { return olderPrefixHash(length) == calculatePrefixHash(length); });
+
+    // hash(last length characters) = hash(all) - hash(the rest) * B^length
+    uint64_t olderHash = olderPrefixHash(olderLength), newerHash = calculatePrefixHash(newerLength);
+    auto suffixHash = [](uint64_t documentHash, uint64_t restHash, size_t length)
+    {
+        uint64_t restPart = piece_table_detail::hashMultiply(restHash, piece_table_detail::hashPower(length));
+        return piece_table_detail::hashReduce(documentHash + piece_table_detail::HASH_MOD - restPart);
+    };
+    suffix = searchCommonLength(maxLength - prefix, [&](size_t length)
+                                { return suffixHash(olderHash, olderPrefixHash(olderLength - length), length) == suffixHash(newerHash, calculatePrefixHash(newerLength - length), length); });
+}
+
+// the lengths of the common beginning and end of the older document and this one, found by walking both from each end
+template <typename Traits>
+void BasicPieceTable<Traits>::findCommonEnds(SpanCursor olderFront, SpanCursor olderBack, size_t olderLength, size_t &prefix, size_t &suffix) const
+{
+    size_t maxLength = std::min(olderLength, getLength());
+    prefix = getCommonLength(olderFront, SpanCursor(this, nullptr, false), maxLength);
+    suffix = getCommonLength(olderBack, SpanCursor(this, nullptr, true), maxLength - prefix);
+}
+
+template <typename Traits>
+BasicPieceTable<Traits>::SpanCursor::SpanCursor(const BasicPieceTable *table, const SpanList *spans, bool fromEnd)
+    : table(table), spans(spans), fromEnd(fromEnd), spanIndex(0), node(nullptr)
+{
+    if (spans == nullptr)
+    {
+        node = fromEnd ? table->findBiggest(table->editTreeRoot) : table->findSmallest(table->editTreeRoot);
+    }
+}
+
+template <typename Traits>
+bool BasicPieceTable<Traits>::SpanCursor::next(PieceSpan &span)
+{
+    if (spans != nullptr)
+    {
+        if (spanIndex == spans->size())
+            return false;
+        span = (*spans)[fromEnd ? spans->size() - spanIndex - 1 : spanIndex];
+        spanIndex++;
+        return true;
+    }
+
+    if (node == nullptr)
+        return false;
+    const Buffer &buffer = table->buffers[node->data.bufferInfex];
+    span = PieceSpan{node->data.bufferInfex, table->toBufferOffset(buffer, node->data.start), table->toBufferOffset(buffer, node->data.end)};
+    node = fromEnd ? table->getPreviousNode(node) : table->getNextNode(node);
+    return true;
+}
+
+/**
+ * Number of equal characters (at most limit) at the start, or the end, of the documents of both cursors.
+ * Characters the documents share through the same buffer range are not read, others are compared a span at a time.
+ */
+template <typename Traits>
+size_t BasicPieceTable<Traits>::getCommonLength(SpanCursor older, SpanCursor newer, size_t limit)
+{
+    PieceSpan olderSpan, newerSpan;
+    bool hasOlder = older.next(olderSpan), hasNewer = newer.next(newerSpan);
+    size_t length = 0;
+    while (hasOlder && hasNewer && length < limit)
+    {
+        size_t count = std::min({olderSpan.end - olderSpan.start, newerSpan.end - newerSpan.start, limit - length});
+        size_t olderStart = older.fromEnd ? olderSpan.end - count : olderSpan.start;
+        size_t newerStart = newer.fromEnd ? newerSpan.end - count : newerSpan.start;
+        if (older.table != newer.table || olderSpan.bufferInfex != newerSpan.bufferInfex || olderStart != newerStart)
+        {
+            const CharType *olderData = older.table->getBufferText(olderSpan.bufferInfex).data() + olderStart;
+            const CharType *newerData = newer.table->getBufferText(newerSpan.bufferInfex).data() + newerStart;
+            size_t equalLength;
+            if (older.fromEnd)
+            {
+                auto olderLast = std::make_reverse_iterator(olderData + count);
+                equalLength = size_t(std::mismatch(olderLast, std::make_reverse_iterator(olderData), std::make_reverse_iterator(newerData + count)).first - olderLast);
+            }
+            else
+            {
+                equalLength = size_t(std::mismatch(olderData, olderData + count, newerData).first - olderData);
+            }
+            if (equalLength != count)
+            {
+                return length + equalLength;
+            }
+        }
+
+        length += count;
+        if (older.fromEnd)
+            olderSpan.end -= count, newerSpan.end -= count;
+        else
+            olderSpan.start += count, newerSpan.start += count;
+        if (olderSpan.start == olderSpan.end)
+            hasOlder = older.next(olderSpan);
+        if (newerSpan.start == newerSpan.end)
+            hasNewer = newer.next(newerSpan);
+    }
+    return length;
+}
+
+// the pieces of the characters [from, to) in order, neighbouring pieces that continue each other in the same buffer are merged
+template <typename Traits>
+auto BasicPieceTable<Traits>::getSpans(size_t from, size_t to) const -> SpanList
+{
+    SpanList spans(buffers.get_allocator());
+    if (from >= to)
+    {
+        return spans;
+    }
+
+    NodePosition position = nodeAt(from);
+    size_t offset = position.nodeStartOffset;
+    for (EditNode *currentNode = position.node; currentNode != nullptr && offset < to; currentNode = getNextNode(currentNode))
+    {
+        const EditPiece &piece = currentNode->data;
+        const Buffer &buffer = buffers[piece.bufferInfex];
+        size_t pieceStart = toBufferOffset(buffer, piece.start), pieceLength = toBufferOffset(buffer, piece.end) - pieceStart;
+        size_t start = pieceStart + (from > offset ? from - offset : 0);
+        size_t end = pieceStart + std::min(pieceLength, to - offset);
+        offset += pieceLength;
+        if (start >= end)
+        {
+            continue; // the piece ends right at from
+        }
+
+        if (!spans.empty() && spans.back().bufferInfex == piece.bufferInfex && spans.back().end == start)
+            spans.back().end = end;
+        else
+            spans.push_back(PieceSpan{piece.bufferInfex, start, end});
+    }
+    return spans;
+}
+
+// the spans of the characters [from, to) of the snapshot
+template <typename Traits>
+auto BasicPieceTable<Traits>::getSnapshotSpans(const Snapshot &snapshot, size_t from, size_t to) -> SpanList
+{
+    SpanList spans(snapshot.spans.get_allocator());
+    size_t span = std::upper_bound(snapshot.offsets.begin(), snapshot.offsets.end(), from) - snapshot.offsets.begin();
+    for (; span < snapshot.spans.size(); span++)
+    {
+        size_t spanStart = span == 0 ? 0 : snapshot.offsets[span - 1];
+        if (spanStart >= to)
+        {
+            break;
+        }
+
+        PieceSpan current = snapshot.spans[span];
+        if (spanStart < from)
+            current.start += from - spanStart;
+        if (snapshot.offsets[span] > to)
+            current.end -= snapshot.offsets[span] - to;
+        spans.push_back(current);
+    }
+    return spans;
+}
+
+/**
+ * Cuts the spans of both lists at every offset where a span of the same buffer starts or ends in either list.
+ * Afterwards text that both documents share through the same buffer is made of identical spans.
+ */
+template <typename Traits>
+void BasicPieceTable<Traits>::splitSharedSpans(SpanList &older, SpanList &newer)
+{
+    std::vector<std::pair<size_t, size_t>> cuts;
+    cuts.reserve(2 * (older.size() + newer.size()));
+    for (const SpanList *spans : {&older, &newer})
+    {
+        for (const PieceSpan &span : *spans)
+        {
+            cuts.emplace_back(span.bufferInfex, span.start);
+            cuts.emplace_back(span.bufferInfex, span.end);
+        }
+    }
+    std::sort(cuts.begin(), cuts.end());
+    cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+
+    for (SpanList *spans : {&older, &newer})
+    {
+        SpanList splitSpans(spans->get_allocator());
+        splitSpans.reserve(spans->size());
+        for (const PieceSpan &span : *spans)
+        {
+            size_t start = span.start;
+            auto cut = std::upper_bound(cuts.begin(), cuts.end(), std::make_pair(span.bufferInfex, span.start));
+            for (; cut != cuts.end() && cut->first == span.bufferInfex && cut->second < span.end; cut++)
+            {
+                splitSpans.push_back(PieceSpan{span.bufferInfex, start, cut->second});
+                start = cut->second;
+            }
+            splitSpans.push_back(PieceSpan{span.bufferInfex, start, span.end});
+        }
+        spans->swap(splitSpans);
+    }
+}
+
+// the text of spans [from, to)
+template <typename Traits>
+auto BasicPieceTable<Traits>::getSpansText(const BasicPieceTable &table, const SpanList &spans, size_t from, size_t to) -> String
+{
+    String retString(table.buffers.get_allocator());
+    for (size_t i = from; i < to; i++)
+    {
+        retString.append(table.getBufferText(spans[i].bufferInfex), spans[i].start, spans[i].end - spans[i].start);
+    }
+    return retString;
+}
+
+// the end of the line that starts at start, after its line break
+template <typename Traits>
+size_t BasicPieceTable<Traits>::getLineEnd(const CharType *text, size_t length, size_t start)
+{
+    return std::min(size_t(std::find(text + start, text + length, CharType('\n')) - text) + 1, length);
+}
+
+// the starts of the lines (or parts of a line at the ends) that occur exactly once in both texts, in the same order in both
+template <typename Traits>
+std::vector<std::pair<size_t, size_t>> BasicPieceTable<Traits>::getUniqueLineMatches(const CharType *older, size_t olderLength, const CharType *newer, size_t newerLength)
+{
+    using Line = std::basic_string_view<CharType>;
+    struct Occurrences
+    {
+        size_t olderCount = 0, olderStart = 0;
+        size_t newerCount = 0, newerStart = 0;
+    };
+
+    std::unordered_map<Line, Occurrences> lines;
+    for (size_t start = 0, end; start < olderLength; start = end)
+    {
+        end = getLineEnd(older, olderLength, start);
+        Occurrences &occurrences = lines[Line(older + start, end - start)];
+        occurrences.olderCount++;
+        occurrences.olderStart = start;
+    }
+    for (size_t start = 0, end; start < newerLength; start = end)
+    {
+        end = getLineEnd(newer, newerLength, start);
+        auto occurrences = lines.find(Line(newer + start, end - start));
+        if (occurrences != lines.end())
+        {
+            occurrences->second.newerCount++;
+            occurrences->second.newerStart = start;
+        }
+    }
+
+    std::vector<std::pair<size_t, size_t>> candidates;
+    for (size_t start = 0, end; start < olderLength; start = end)
+    {
+        end = getLineEnd(older, olderLength, start);
+        const Occurrences &occurrences = lines[Line(older + start, end - start)];
+        if (occurrences.olderCount == 1 && occurrences.newerCount == 1)
+            candidates.emplace_back(occurrences.olderStart, occurrences.newerStart);
+    }
+    return piece_table_detail::increasingMatches(candidates);
+}
+
+/**
+ * Appends the changes that turn the older text into the newer one, the offsets are where both texts start in
+ * their documents. Lines that occur once in both texts are matched first (patience diff) and the text between
+ * them is diffed on its own, so the limited character diff only runs between neighbouring lines.
+ */
+template <typename Traits>
+void BasicPieceTable<Traits>::diffText(const CharType *older, size_t olderLength, const CharType *newer, size_t newerLength, size_t olderOffset, size_t newerOffset, DiffList &changes)
+{
+    size_t prefix = std::mismatch(older, older + std::min(olderLength, newerLength), newer).first - older;
+    older += prefix, olderLength -= prefix, olderOffset += prefix;
+    newer += prefix, newerLength -= prefix, newerOffset += prefix;
+    auto olderEnd = std::make_reverse_iterator(older + olderLength);
+    size_t suffix = std::mismatch(olderEnd, olderEnd + std::min(olderLength, newerLength), std::make_reverse_iterator(newer + newerLength)).first - olderEnd;
+    olderLength -= suffix;
+    newerLength -= suffix;
+    if (olderLength == 0 || newerLength == 0)
+    {
+        if (olderLength != newerLength)
+            changes.push_back(DiffRange{olderOffset, olderLength, newerOffset, newerLength});
+        return;
+    }
+
+    std::vector<std::pair<size_t, size_t>> matches = getUniqueLineMatches(older, olderLength, newer, newerLength);
+    if (!matches.empty())
+    {
+        // each part between two matched lines is smaller than the whole, so this ends
+        size_t olderNext = 0, newerNext = 0;
+        for (const std::pair<size_t, size_t> &match : matches)
+        {
+            diffText(older + olderNext, match.first - olderNext, newer + newerNext, match.second - newerNext, olderOffset + olderNext, newerOffset + newerNext, changes);
+            size_t lineLength = getLineEnd(older, olderLength, match.first) - match.first;
+            olderNext = match.first + lineLength;
+            newerNext = match.second + lineLength;
+        }
+        diffText(older + olderNext, olderLength - olderNext, newer + newerNext, newerLength - newerNext, olderOffset + olderNext, newerOffset + newerNext, changes);
+        return;
+    }
+
+    // the length difference alone tells when the character diff would fail, without running it
+    if (std::max(olderLength, newerLength) - std::min(olderLength, newerLength) > MAX_CHAR_DIFF_EDITS ||
+        !piece_table_detail::myersDiff(olderLength, newerLength, [&](size_t i, size_t j)
+                                       { return older[i] == newer[j]; }, MAX_CHAR_DIFF_EDITS, matches))
+    {
+        matches.clear();
+    }
+    matches.emplace_back(olderLength, newerLength);
+
+    size_t olderNext = 0, newerNext = 0;
+    for (const std::pair<size_t, size_t> &match : matches)
+    {
+        if (match.first != olderNext || match.second != newerNext)
+        {
+            changes.push_back(DiffRange{olderOffset + olderNext, match.first - olderNext, newerOffset + newerNext, match.second - newerNext});
+        }
+        olderNext = match.first + 1;
+        newerNext = match.second + 1;
+    }
+}
+
+/**
+ * Diffs two documents piece by piece. Within one table every buffer range is in a document at most once
+ * (text is never copied between pieces) and the ranges both documents keep stay in order, so after
+ * splitSharedSpans the spans with the same (buffer, start) are matched as anchors in linear time. Only the
+ * text between neighbouring anchors is diffed, the documents of different tables are diffed as text.
+ */
+template <typename Traits>
+auto BasicPieceTable<Traits>::diffSpans(const BasicPieceTable &olderTable, SpanList older, const BasicPieceTable &newerTable, SpanList newer, size_t offset) -> DiffList
+{
+    std::vector<std::pair<size_t, size_t>> anchors;
+    if (&olderTable == &newerTable)
+    {
+        splitSharedSpans(older, newer);
+
+        struct SpanKeyHash
+        {
+            size_t operator()(const std::pair<size_t, size_t> &key) const
+            {
+                return std::hash<size_t>()(key.first * 0x9E3779B97F4A7C15ull + key.second);
+            }
+        };
+        std::unordered_map<std::pair<size_t, size_t>, size_t, SpanKeyHash> newerSpans(newer.size());
+        for (size_t j = 0; j < newer.size(); j++)
+        {
+            newerSpans.emplace(std::make_pair(newer[j].bufferInfex, newer[j].start), j);
+        }
+        for (size_t i = 0; i < older.size(); i++)
+        {
+            auto match = newerSpans.find(std::make_pair(older[i].bufferInfex, older[i].start));
+            if (match != newerSpans.end())
+                anchors.emplace_back(i, match->second);
+        }
+        anchors = piece_table_detail::increasingMatches(anchors);
+    }
+    // a sentinel anchor right after the spans closes the last gap
+    anchors.emplace_back(older.size(), newer.size());
+
+    DiffList changes(newerTable.buffers.get_allocator());
+    size_t olderOffset = offset, newerOffset = offset;
+    size_t olderNext = 0, newerNext = 0;
+    for (const std::pair<size_t, size_t> &anchor : anchors)
+    {
+        // spans [olderNext, anchor.first) were replaced by [newerNext, anchor.second)
+        if (anchor.first != olderNext || anchor.second != newerNext)
+        {
+            String olderText = getSpansText(olderTable, older, olderNext, anchor.first);
+            String newerText = getSpansText(newerTable, newer, newerNext, anchor.second);
+            diffText(olderText.data(), olderText.size(), newerText.data(), newerText.size(), olderOffset, newerOffset, changes);
+            olderOffset += olderText.size();
+            newerOffset += newerText.size();
+        }
+
+        if (anchor.first != older.size())
+        {
+            olderOffset += older[anchor.first].end - older[anchor.first].start;
+            newerOffset += newer[anchor.second].end - newer[anchor.second].start;
+        }
+        olderNext = anchor.first + 1;
+        newerNext = anchor.second + 1;
+    }
+
+    return changes;
+}
+
+template <typename Traits>
+BasicPieceTable<Traits>::ChangeStream::ChangeStream(BasicPieceTable &table) : table(&table), next(table.changeStreams), pending(table.buffers.get_allocator())
+{
+    table.changeStreams = this;
+}
+
+template <typename Traits>
+BasicPieceTable<Traits>::ChangeStream::~ChangeStream()
+{
+    if (table != nullptr)
+    {
+        ChangeStream **link = &table->changeStreams;
+        while (*link != this)
+        {
+            link = &(*link)->next;
+        }
+        *link = next;
+    }
+}
+
+template <typename Traits>
+bool BasicPieceTable<Traits>::ChangeStream::empty() const
+{
+    return pending.empty();
+}
+
+template <typename Traits>
+auto BasicPieceTable<Traits>::ChangeStream::take() -> ChangeList
+{
+    ChangeList events(pending.get_allocator());
+    events.swap(pending);
+    return events;
+}
+
+/**
+ * Merges the event into the last pending one when the text it removes touches the text the last one inserted.
+ * The merged event describes both edits relative to the document before the first of them.
+ */
+template <typename Traits>
+void BasicPieceTable<Traits>::ChangeStream::push(const ChangeEvent &event)
+{
+    if (pending.empty())
+    {
+        pending.push_back(event);
+        return;
+    }
+
+    ChangeEvent &previous = pending.back();
+    if (event.offset > previous.offset + previous.insertedLength || event.offset + event.removedLength < previous.offset)
+    {
+        pending.push_back(event);
+        return;
+    }
+
+    // the merged range, in the document between both edits
+    size_t start = std::min(previous.offset, event.offset);
+    size_t end = std::max(previous.offset + previous.insertedLength, event.offset + event.removedLength);
+    size_t startLine = std::min(previous.startLine, event.startLine);
+    size_t endLine = std::max(previous.newEndLine, event.oldEndLine);
+
+    ChangeEvent merged;
+    merged.offset = start;
+    merged.removedLength = end - start - previous.insertedLength + previous.removedLength;
+    merged.insertedLength = end - start - event.removedLength + event.insertedLength;
+    merged.startLine = startLine;
+    merged.oldEndLine = endLine - previous.newEndLine + previous.oldEndLine;
+    merged.newEndLine = endLine - event.oldEndLine + event.newEndLine;
+
+    if (merged.removedLength == 0 && merged.insertedLength == 0)
+        pending.pop_back(); // the second edit undid the first one
+    else
+        previous = merged;
+}
+
+// the journal already holds the text of the buffers, the checkpoint only lists the spans
+template <typename Traits>
+void BasicPieceTable<Traits>::writeJournalCheckpoint(const SpanList &spans)
+{
+    std::vector<size_t> pieces;
+    pieces.reserve(3 * spans.size());
+    for (const PieceSpan &span : spans)
+    {
+        pieces.push_back(span.bufferInfex);
+        pieces.push_back(span.start);
+        pieces.push_back(span.end);
+    }
+    journal.writeCheckpoint(pieces);
+}
+
+template <typename Traits>
+bool BasicPieceTable<Traits>::startJournal(const std::string &path)
+{
+    journal.create(path, sizeof(CharType), JOURNAL_SYNC_INTERVAL_MS);
+
+    // the new journal starts with the buffers the pieces use, in the order of their indexes
+    SpanList spans = getSpans(0, getLength());
+    std::vector<size_t> usedBuffers;
+    usedBuffers.reserve(spans.size());
+    for (const PieceSpan &span : spans)
+    {
+        usedBuffers.push_back(span.bufferInfex);
+    }
+    std::sort(usedBuffers.begin(), usedBuffers.end());
+    usedBuffers.erase(std::unique(usedBuffers.begin(), usedBuffers.end()), usedBuffers.end());
+    for (size_t bufferIndex : usedBuffers)
+    {
+        const String &text = getBufferText(bufferIndex);
+        journal.writeBuffer(bufferIndex, text.data(), text.size());
+    }
+
+    writeJournalCheckpoint(spans);
+    return journal.isOpen();
+}
+
+template <typename Traits>
+bool BasicPieceTable<Traits>::checkpointJournal()
+{
+    if (journal.hasEditsSinceCheckpoint())
+    {
+        writeJournalCheckpoint(getSpans(0, getLength()));
+    }
+    return journal.isOpen();
+}
+
+template <typename Traits>
+bool BasicPieceTable<Traits>::syncJournal()
+{
+    return journal.sync();
+}
+
+template <typename Traits>
+void BasicPieceTable<Traits>::stopJournal()
+{
+    journal.close();
+}
+
+template <typename Traits>
+bool BasicPieceTable<Traits>::isJournaling() const
+{
+    return journal.isOpen();
+}
+
+/**
+ * Rebuilds an empty table from a journal: loads the buffers, restores the pieces of the last checkpoint
+ * and replays the edits made after it. Afterwards the table keeps writing to the same journal.
+ */
+template <typename Traits>
+bool BasicPieceTable<Traits>::recoverJournal(const std::string &path)
+{
+    // the buffers would be written to the attached journal while they are loaded
+    if (editTreeRoot != nullptr || !buffers.empty() || journal.isOpen())
+    {
+        return false;
+    }
+
+    piece_table_detail::JournalContent content;
+    if (!piece_table_detail::Journal::read(path, sizeof(CharType), content))
+    {
+        return false;
+    }
+
+    // the buffers get their numbers in the journal as indexes
+    String text(buffers.get_allocator());
+    buffers.reserve(content.buffers.size());
+    for (const piece_table_detail::JournalBuffer &buffer : content.buffers)
+    {
+        text.resize(buffer.length);
+        std::memcpy(&text[0], content.file.data() + buffer.textOffset, buffer.length * sizeof(CharType));
+        insertBuffer(text.data(), text.size());
+    }
+
+    PieceList pieces(buffers.get_allocator());
+    for (size_t i = 0; i < content.pieces.size(); i += 3)
+    {
+        pieces.push_back(createPiece(content.pieces[i], content.pieces[i + 1], content.pieces[i + 2]));
+    }
+    insertPieces(0, pieces);
+
+    bool valid = true;
+    for (size_t i = 0; i < content.edits.size() && valid; i += 4)
+    {
+        size_t index = content.edits[i], length = content.edits[i + 1];
+        valid = index <= getLength() && length <= getLength() - index;
+        if (valid)
+        {
+            pieces.clear();
+            for (size_t buffer = content.edits[i + 2]; buffer < content.edits[i + 2] + content.edits[i + 3]; buffer++)
+            {
+                pieces.push_back(createPiece(buffer, 0, content.buffers[buffer].length));
+            }
+            removePieces(index, length);
+            insertPieces(index, pieces);
+        }
+    }
+
+    if (!valid || !journal.resume(path, sizeof(CharType), JOURNAL_SYNC_INTERVAL_MS, content))
+    {
+        destroyTree(editTreeRoot);
+        editTreeRoot = nullptr;
+        buffers.clear();
+        if constexpr (COMPRESS_BUFFERS)
+        {
+            this->hotBuffers.clear();
+        }
+        return false;
+    }
+    return true;
+}
@@ -1,7 +1,481 @@
+#include <cstdio>
+#include <filesystem>
 #include <gtest/gtest.h>
 #include <piece_table.hpp>
 
-// TEST(LinkedListTest, Insert)
-// {
-//   EXPECT_EQ(1, 1);
-// }
\ No newline at end of file
+struct SmallNodeTraits : PieceTableTraits<char>
+{
+    static constexpr size_t MAX_CHAR_PER_NODE = 4;
+    static constexpr bool TRACK_UTF16 = true;
+};
+
+struct LeanTraits : PieceTableTraits<char16_t>
+{
+    static constexpr size_t MAX_CHAR_PER_NODE = 3;
+    static constexpr bool TRACK_LINES = false;
+};
+
+TEST(PieceTableTest, Insert)
+{
+    PieceTable table;
+    table.insert(0, "world").insert(0, "hello ").insert(5, ",").insert(12, "!");
+
+    EXPECT_EQ(table.getText(), "hello, world!");
+    EXPECT_EQ(table.getLength(), 13u);
+    EXPECT_EQ(table.getText(7, 5), "world");
+}
+
+TEST(PieceTableTest, InsertMatchesString)
+{
+    BasicPieceTable<SmallNodeTraits> table;
+    std::string expected;
+    for (size_t i = 0; i < 200; i++)
+    {
+        std::string data = std::to_string(i) + (i % 7 == 0 ? "\n" : "");
+        size_t index = (i * 31) % (expected.size() + 1);
+        table.insert(index, data);
+        expected.insert(index, data);
+        ASSERT_EQ(table.getText(), expected);
+    }
+    EXPECT_EQ(table.getUtf16Length(), expected.size());
+}
+
+TEST(PieceTableTest, GetLineContent)
+{
+    BasicPieceTable<SmallNodeTraits> table;
+    table.insert(0, "first\nthird\n").insert(6, "second\n").insert(19, "last");
+
+    EXPECT_EQ(table.getLineCount(), 4u);
+    EXPECT_EQ(table.getLineContent(0), "first");
+    EXPECT_EQ(table.getLineContent(1), "second");
+    EXPECT_EQ(table.getLineContent(2), "third");
+    EXPECT_EQ(table.getLineContent(3), "last");
+}
+
+TEST(PieceTableTest, Utf16Length)
+{
+    BasicPieceTable<SmallNodeTraits> table;
+    table.insert(0, "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80"); // a, e acute, euro sign, emoji
+
+    EXPECT_EQ(table.getUtf16Length(), 5u);
+}
+
+TEST(PieceTableTest, LeanTraits)
+{
+    BasicPieceTable<LeanTraits> table;
+    table.insert(0, u"line\nbreaks").insert(4, u" with");
+
+    EXPECT_EQ(table.getText(), u"line with\nbreaks");
+    // the tree, the buffers and one pointer each for the change streams and the journal
+    EXPECT_LE(sizeof(table), 7 * sizeof(void *));
+}
+
+struct HashTraits : PieceTableTraits<char>
+{
+    static constexpr size_t MAX_CHAR_PER_NODE = 5;
+    static constexpr bool TRACK_HASH = true;
+};
+
+TEST(PieceTableTest, HashDependsOnTextOnly)
+{
+    BasicPieceTable<HashTraits> first, second, third;
+    first.insert(0, "the quick brown fox");
+    second.insert(0, "fox").insert(0, "the brown ").insert(4, "quick ");
+    third.insert(0, "the quick brown fix");
+
+    EXPECT_EQ(first.getHash(), second.getHash());
+    EXPECT_NE(first.getHash(), third.getHash());
+}
+
+TEST(PieceTableTest, RangeHash)
+{
+    BasicPieceTable<HashTraits> table, range;
+    table.insert(0, "0123456789abcdefghij").insert(10, "KLMNOP");
+    range.insert(0, "789KLMNOPab");
+
+    EXPECT_EQ(table.getHash(7, 11), range.getHash());
+    EXPECT_EQ(table.getHash(0, table.getLength()), table.getHash());
+    EXPECT_EQ(table.getHash(3, 0), 0u);
+}
+
+TEST(PieceTableTest, CommonPrefixLength)
+{
+    BasicPieceTable<HashTraits> first, second;
+    first.insert(0, "shared prefix, then a change");
+    second.insert(0, "shared prefix, then another change");
+
+    EXPECT_EQ(first.getCommonPrefixLength(second), 21u);
+    EXPECT_EQ(first.getCommonPrefixLength(first), first.getLength());
+}
+
+TEST(PieceTableTest, DiffSnapshot)
+{
+    PieceTable table;
+    table.insert(0, std::string(1000, 'a'));
+    PieceTable::Snapshot saved = table.takeSnapshot();
+    table.insert(500, "inserted").insert(10, "x");
+
+    PieceTable::DiffList changes = table.diff(saved);
+    ASSERT_EQ(changes.size(), 2u);
+    EXPECT_EQ(changes[0].oldIndex, 10u);
+    EXPECT_EQ(changes[0].oldLength, 0u);
+    EXPECT_EQ(changes[0].newIndex, 10u);
+    EXPECT_EQ(changes[0].newLength, 1u);
+    EXPECT_EQ(changes[1].oldIndex, 500u);
+    EXPECT_EQ(changes[1].oldLength, 0u);
+    EXPECT_EQ(changes[1].newIndex, 501u);
+    EXPECT_EQ(changes[1].newLength, 8u);
+    EXPECT_TRUE(table.diff(table.takeSnapshot()).empty());
+}
+
+TEST(PieceTableTest, DiffTables)
+{
+    PieceTable older, newer;
+    older.insert(0, "the quick brown fox jumps over the lazy dog");
+    newer.insert(0, "the quick red fox jumps over the lazy cat");
+
+    PieceTable::DiffList changes = newer.diff(older);
+    std::string text = older.getText();
+    for (auto it = changes.rbegin(); it != changes.rend(); it++)
+    {
+        text.replace(it->oldIndex, it->oldLength, newer.getText(it->newIndex, it->newLength));
+    }
+    EXPECT_EQ(text, newer.getText());
+    EXPECT_TRUE(newer.diff(newer).empty());
+}
+
+TEST(PieceTableTest, DiffManyScatteredEdits)
+{
+    // lines of 11 characters, far more edits than a single diff pass would handle
+    std::string text;
+    for (int line = 0; line < 20000; line++)
+    {
+        char number[16];
+        std::snprintf(number, sizeof(number), "line %05d\n", line);
+        text += number;
+    }
+    PieceTable table, copy;
+    table.insert(0, text);
+    copy.insert(0, text);
+    PieceTable::Snapshot saved = table.takeSnapshot();
+    for (size_t line = 1500; line-- > 0;)
+    {
+        table.insert(line * 13 * 11 + 2, "x");
+    }
+
+    for (const PieceTable::DiffList &changes : {table.diff(saved), table.diff(copy)})
+    {
+        ASSERT_EQ(changes.size(), 1500u);
+        for (size_t i = 0; i < changes.size(); i++)
+        {
+            EXPECT_EQ(changes[i].oldIndex, i * 13 * 11 + 2);
+            EXPECT_EQ(changes[i].oldLength, 0u);
+            EXPECT_EQ(changes[i].newIndex, i * 13 * 11 + 2 + i);
+            EXPECT_EQ(changes[i].newLength, 1u);
+        }
+    }
+}
+
+TEST(PieceTableTest, DiffWithHashes)
+{
+    BasicPieceTable<HashTraits> table, copy;
+    table.insert(0, "the quick brown fox jumps over the lazy dog");
+    copy.insert(0, table.getText());
+    BasicPieceTable<HashTraits>::Snapshot saved = table.takeSnapshot();
+    table.replace(10, 5, "pale").remove(0, 4);
+
+    for (const BasicPieceTable<HashTraits>::DiffList &changes : {table.diff(saved), table.diff(copy)})
+    {
+        ASSERT_EQ(changes.size(), 2u);
+        EXPECT_EQ(changes[0].oldIndex, 0u);
+        EXPECT_EQ(changes[0].oldLength, 4u);
+        EXPECT_EQ(changes[0].newLength, 0u);
+        EXPECT_EQ(changes[1].oldIndex, 10u);
+        EXPECT_EQ(changes[1].newIndex, 6u);
+        EXPECT_EQ(table.getText(changes[1].newIndex, changes[1].newLength), "pale");
+    }
+    EXPECT_TRUE(table.diff(table.takeSnapshot()).empty());
+}
+
+TEST(PieceTableTest, RemoveAndReplace)
+{
+    BasicPieceTable<SmallNodeTraits> table;
+    table.insert(0, "first line\nsecond line\nthird line");
+    table.remove(6, 5).replace(13, 5, "row\n");
+
+    EXPECT_EQ(table.getText(), "first second row\nthird line");
+    EXPECT_EQ(table.getLineCount(), 2u);
+    EXPECT_EQ(table.getLineContent(0), "first second row");
+    EXPECT_EQ(table.getUtf16Length(), table.getLength());
+
+    table.remove(0, table.getLength());
+    EXPECT_EQ(table.getText(), "");
+}
+
+TEST(PieceTableTest, HashAfterRemoveAndReplace)
+{
+    BasicPieceTable<HashTraits> table;
+    std::string expected;
+    for (size_t i = 0; i < 100; i++)
+    {
+        std::string data = std::to_string(i * 7);
+        table.insert((i * 13) % (expected.size() + 1), data);
+        expected.insert((i * 13) % (expected.size() + 1), data);
+    }
+
+    // removes of whole nodes, node parts and nodes with two children, each followed by rebalancing
+    for (size_t i = 0; i < 60; i++)
+    {
+        size_t index = (i * 37) % expected.size();
+        if (i % 2 == 0)
+        {
+            table.remove(index, i % 9 + 1);
+            expected.erase(index, i % 9 + 1);
+        }
+        else
+        {
+            table.replace(index, i % 4, "r" + std::to_string(i));
+            expected.replace(index, i % 4, "r" + std::to_string(i));
+        }
+
+        BasicPieceTable<HashTraits> fresh;
+        fresh.insert(0, expected);
+        ASSERT_EQ(table.getText(), expected);
+        ASSERT_EQ(table.getHash(), fresh.getHash());
+        ASSERT_EQ(table.getHash(index / 2, expected.size() / 3), fresh.getHash(index / 2, expected.size() / 3));
+    }
+}
+
+TEST(PieceTableTest, ChangeStreamCoalescesEdits)
+{
+    PieceTable table;
+    table.insert(0, "line one\nline two\n");
+    PieceTable::ChangeStream stream(table);
+
+    // typing a word with a typo at the start of the second line
+    table.insert(9, "n").insert(10, "e").insert(11, "x").remove(11, 1).insert(11, "w\n");
+    table.insert(0, "top ");
+
+    PieceTable::ChangeList events = stream.take();
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_EQ(events[0].offset, 9u);
+    EXPECT_EQ(events[0].removedLength, 0u);
+    EXPECT_EQ(events[0].insertedLength, 4u);
+    EXPECT_EQ(events[0].startLine, 1u);
+    EXPECT_EQ(events[0].oldEndLine, 1u);
+    EXPECT_EQ(events[0].newEndLine, 2u);
+    EXPECT_EQ(events[1].offset, 0u);
+    EXPECT_EQ(events[1].insertedLength, 4u);
+    EXPECT_TRUE(stream.empty());
+}
+
+TEST(PieceTableTest, ChangeStreamsDetach)
+{
+    PieceTable::ChangeStream *outliving;
+    {
+        PieceTable table;
+        PieceTable::ChangeStream first(table);
+        {
+            PieceTable::ChangeStream second(table);
+            PieceTable::ChangeStream third(table);
+            table.insert(0, "a");
+            EXPECT_EQ(second.take().size(), 1u);
+        }
+        outliving = new PieceTable::ChangeStream(table);
+        table.insert(1, "b");
+        EXPECT_EQ(first.take().size(), 1u);
+        EXPECT_EQ(outliving->take().size(), 1u);
+    }
+    delete outliving;
+}
+
+struct CompressedTraits : PieceTableTraits<char>
+{
+    static constexpr size_t MAX_CHAR_PER_NODE = 1024;
+    static constexpr bool COMPRESS_BUFFERS = true;
+    static constexpr size_t HOT_BUFFER_COUNT = 2;
+};
+
+TEST(PieceTableTest, CompressedBuffers)
+{
+    BasicPieceTable<CompressedTraits> table;
+    std::string expected;
+    for (size_t i = 0; i < 500; i++)
+    {
+        expected += "12:00:" + std::to_string(i % 60) + " INFO request " + std::to_string(i) + " served\n";
+    }
+    table.insert(0, expected);
+    EXPECT_EQ(table.getText(), expected);
+
+    // all but the two hot buffers got cold while the text was read
+    BasicPieceTable<CompressedTraits>::BufferStatistics statistics = table.getBufferStatistics();
+    EXPECT_LE(statistics.textBytes, 2 * CompressedTraits::MAX_CHAR_PER_NODE);
+    EXPECT_GE(statistics.compressedBuffers, expected.size() / CompressedTraits::MAX_CHAR_PER_NODE - 2);
+
+    table.compressBuffers();
+    statistics = table.getBufferStatistics();
+    EXPECT_EQ(statistics.textBytes, 0u);
+    EXPECT_LT(statistics.compressedBytes, expected.size() / 2);
+
+    table.replace(5000, 10, "edited").insert(0, "more\n");
+    expected.replace(5000, 10, "edited").insert(0, "more\n");
+
+    EXPECT_EQ(table.getText(), expected);
+    EXPECT_EQ(table.getLineContent(0), "more");
+    EXPECT_EQ(table.getText(9000, 20), expected.substr(9000, 20));
+}
+
+struct JournalTraits : PieceTableTraits<char>
+{
+    static constexpr size_t MAX_CHAR_PER_NODE = 8;
+};
+
+TEST(PieceTableTest, RecoverJournal)
+{
+    std::string path = (std::filesystem::temp_directory_path() / "piece_table_recover.journal").string();
+    std::string expected = "existing text\n";
+    {
+        BasicPieceTable<JournalTraits> table;
+        table.insert(0, expected);
+        ASSERT_TRUE(table.startJournal(path));
+        for (size_t i = 0; i < 40; i++)
+        {
+            std::string data = "line " + std::to_string(i) + "\n";
+            size_t index = (i * 17) % (expected.size() + 1);
+            table.insert(index, data);
+            expected.insert(index, data);
+            if (i % 3 == 0)
+            {
+                table.replace(index / 2, 3, "x");
+                expected.replace(index / 2, 3, "x");
+            }
+            if (i % 16 == 15)
+            {
+                ASSERT_TRUE(table.checkpointJournal());
+            }
+        }
+    }
+
+    // an empty table that journals itself would write the recovered buffers into its own journal
+    std::string otherPath = path + ".other";
+    BasicPieceTable<JournalTraits> journaling;
+    ASSERT_TRUE(journaling.startJournal(otherPath));
+    EXPECT_FALSE(journaling.recoverJournal(path));
+    journaling.stopJournal();
+    std::filesystem::remove(otherPath);
+
+    BasicPieceTable<JournalTraits> recovered;
+    ASSERT_TRUE(recovered.recoverJournal(path));
+    EXPECT_EQ(recovered.getText(), expected);
+
+    recovered.remove(0, 5).insert(0, "again");
+    recovered.stopJournal();
+    BasicPieceTable<JournalTraits> again;
+    ASSERT_TRUE(again.recoverJournal(path));
+    EXPECT_EQ(again.getText(), recovered.getText());
+    std::filesystem::remove(path);
+}
+
+TEST(PieceTableTest, RecoverJournalDropsTornRecord)
+{
+    std::string path = (std::filesystem::temp_directory_path() / "piece_table_torn.journal").string();
+    {
+        PieceTable table;
+        ASSERT_TRUE(table.startJournal(path));
+        table.insert(0, "kept");
+        table.insert(4, " lost");
+    }
+    // a crash in the middle of the last record
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+
+    PieceTable recovered;
+    ASSERT_TRUE(recovered.recoverJournal(path));
+    EXPECT_EQ(recovered.getText(), "kept");
+
+    recovered.insert(4, "!");
+    recovered.stopJournal();
+    PieceTable again;
+    ASSERT_TRUE(again.recoverJournal(path));
+    EXPECT_EQ(again.getText(), "kept!");
+    std::filesystem::remove(path);
+}
+
+TEST(PieceTableTest, JournalCheckpointsHoldNoText)
+{
+    std::string path = (std::filesystem::temp_directory_path() / "piece_table_checkpoint.journal").string();
+    PieceTable table;
+    table.insert(0, std::string(10000, 'a'));
+    ASSERT_TRUE(table.startJournal(path));
+    table.insert(5000, "b");
+    ASSERT_TRUE(table.syncJournal());
+    uintmax_t journalSize = std::filesystem::file_size(path);
+
+    // the checkpoint lists the 52 pieces, their text is in the journal already
+    ASSERT_TRUE(table.checkpointJournal());
+    ASSERT_TRUE(table.syncJournal());
+    EXPECT_LT(std::filesystem::file_size(path), journalSize + 400);
+
+    table.remove(0, 1);
+    PieceTable recovered;
+    table.stopJournal();
+    ASSERT_TRUE(recovered.recoverJournal(path));
+    EXPECT_EQ(recovered.getText(), table.getText());
+    std::filesystem::remove(path);
+}
+
+TEST(PieceTableTest, JournalHoldsLiveTextOnly)
+{
+    std::string path = (std::filesystem::temp_directory_path() / "piece_table_compact.journal").string();
+    BasicPieceTable<JournalTraits> table;
+    table.insert(0, std::string(1000, 'a'));
+    ASSERT_TRUE(table.startJournal(path));
+    for (size_t i = 0; i < 5000; i++)
+    {
+        table.replace((i * 7) % 1000, 1, std::string(1, char('b' + i % 20)));
+        if (i % 250 == 249)
+        {
+            ASSERT_TRUE(table.checkpointJournal());
+        }
+    }
+    ASSERT_TRUE(table.syncJournal());
+
+    // the 5000 edits alone take more than 100000 bytes, the writer replaced the file by the buffers that are
+    // used (about 1000 of 11 bytes each) and the checkpoint whenever they were at most half of it
+    EXPECT_LT(std::filesystem::file_size(path), 60000u);
+    table.stopJournal();
+    BasicPieceTable<JournalTraits> recovered;
+    ASSERT_TRUE(recovered.recoverJournal(path));
+    EXPECT_EQ(recovered.getText(), table.getText());
+
+    // the recovered table continues the compacted journal, where its buffers have other numbers
+    recovered.replace(3, 1, "z").insert(0, "new");
+    ASSERT_TRUE(recovered.checkpointJournal());
+    recovered.remove(10, 5);
+    recovered.stopJournal();
+    BasicPieceTable<JournalTraits> again;
+    ASSERT_TRUE(again.recoverJournal(path));
+    EXPECT_EQ(again.getText(), recovered.getText());
+    std::filesystem::remove(path);
+}
+
+TEST(PieceTableTest, JournalReportsWriteErrors)
+{
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "piece_table_journal_error";
+    std::filesystem::create_directories(directory);
+    PieceTable table;
+    ASSERT_TRUE(table.startJournal((directory / "document.journal").string()));
+    table.insert(0, std::string(100, 'x'));
+    ASSERT_TRUE(table.syncJournal());
+
+    // most of the journal is dead after the replace, so the next checkpoint compacts it into a new file,
+    // which can not be created anymore
+    std::filesystem::remove_all(directory);
+    table.replace(0, 100, "text");
+    EXPECT_TRUE(table.checkpointJournal());
+    EXPECT_FALSE(table.syncJournal());
+    EXPECT_FALSE(table.isJournaling());
+
+    table.insert(4, " more");
+    EXPECT_EQ(table.getText(), "text more");
+    EXPECT_FALSE(table.isJournaling());
+}